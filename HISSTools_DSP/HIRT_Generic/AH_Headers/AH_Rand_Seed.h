@@ -12,6 +12,10 @@
 #ifndef _AH_RAND_SEED_
 #define _AH_RAND_SEED_
 
+#if !defined(__APPLE__) && !defined(_WIN32)
+#include <sys/random.h>
+#endif
+
 
 // Seed the random number generator randomly using OS specific routines
 
@@ -21,6 +25,9 @@ static __inline unsigned int get_rand_seed ()
 	
 #ifdef __APPLE__
 	seed = arc4random();
+#elif !defined(_WIN32)
+	if (getrandom(&seed, sizeof(seed), 0) != sizeof(seed))
+		return 0;
 #else
 	HCRYPTPROV hProvider = 0;
 	const DWORD dwLength = 4;
@@ -0,0 +1,83 @@
+
+/*
+ *  AH_Threads
+ *
+ *	This header file provides a minimal cross-platform wrapper for creating and joining worker threads (pthreads or windows threads)
+ *
+ */
+
+
+#ifndef _AH_THREADS_
+#define _AH_THREADS_
+
+#include <AH_Types.h>
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t t_ah_thread;
+typedef void *(*t_ah_thread_routine)(void *);
+
+#define AH_THREAD_RETURN void *
+#define AH_THREAD_RESULT 0
+
+#else
+
+#include <windows.h>
+
+typedef HANDLE t_ah_thread;
+typedef LPTHREAD_START_ROUTINE t_ah_thread_routine;
+
+#define AH_THREAD_RETURN DWORD WINAPI
+#define AH_THREAD_RESULT 0
+
+#endif
+
+
+// Create a thread running the given routine (returns false on failure)
+
+static __inline AH_Boolean ah_thread_create(t_ah_thread *thread, t_ah_thread_routine routine, void *arg)
+{
+#ifndef _WIN32
+	return pthread_create(thread, 0, routine, arg) ? false : true;
+#else
+	*thread = CreateThread(0, 0, routine, arg, 0, 0);
+	return *thread ? true : false;
+#endif
+}
+
+
+// Wait for a thread to finish and release it
+
+static __inline void ah_thread_join(t_ah_thread thread)
+{
+#ifndef _WIN32
+	pthread_join(thread, 0);
+#else
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#endif
+}
+
+
+// Number of processors available (at least one)
+
+static __inline AH_UIntPtr ah_num_processors()
+{
+	long num_processors;
+
+#ifndef _WIN32
+	num_processors = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	num_processors = (long) info.dwNumberOfProcessors;
+#endif
+
+	return num_processors > 0 ? (AH_UIntPtr) num_processors : 1;
+}
+
+
+#endif		/* _AH_THREADS_ */
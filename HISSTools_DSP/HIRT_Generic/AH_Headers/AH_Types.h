@@ -2,16 +2,16 @@
 #ifndef _AH_TYPES_
 #define _AH_TYPES_
 
-// This needs to be altered to cope with platforms other than windows/mac and compilers other than visual studio and GCC
+// This needs to be altered to cope with compilers other than visual studio, GCC and clang
 
-#ifdef __APPLE__
-#if __LP64__
-#define AH_64BIT
-#endif
-#else
+#ifdef _WIN32
 #ifdef _WIN64
 #define AH_64BIT
 #endif 
+#else
+#if defined(__LP64__) || defined(_LP64)
+#define AH_64BIT
+#endif
 #endif  
 
 
@@ -10,7 +10,7 @@
 #ifndef _AH_WIN_COMPLEX_MATH_
 #define _AH_WIN_COMPLEX_MATH_
 
-#ifdef __APPLE__
+#ifndef _WIN32
 
 #include <math.h>
 #include <complex.h>
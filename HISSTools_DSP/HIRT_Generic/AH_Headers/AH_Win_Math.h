@@ -9,7 +9,7 @@
 #ifndef _AH_WIN_MATH_
 #define _AH_WIN_MATH_
 
-#ifndef __APPLE__
+#ifdef _WIN32
 
 #define _USE_MATH_DEFINES
 
@@ -22,7 +22,7 @@
 
 static __inline double trunc (double t) 
 {
-    return (t > 0.0) ? floor(r) : ceil(t);
+    return (t > 0.0) ? floor(t) : ceil(t);
 }
 
 static __inline double round (double r) 
@@ -0,0 +1,389 @@
+
+#include "HIRT_Deconvolution.h"
+
+#include <AH_Threads.h>
+#include <stdlib.h>
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////// Create / Destroy ////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+t_deconvolve *create_deconvolve(t_ess *sweep, AH_UIntPtr max_rec_length, double reg_in_db, double reg_out_db)
+{
+	t_deconvolve *x;
+	FFT_SPLIT_COMPLEX_D filter;
+	
+	double *sweep_buf;
+	double reg_in, reg_out, reg_val;
+	double max_power = 0.;
+	double power, freq_mul;
+	
+	AH_UIntPtr T = ess_get_length(sweep);
+	AH_UIntPtr fft_size_log2 = 0;
+	AH_UIntPtr fft_size, i;
+	
+	if (!T)
+		return 0;
+	
+	// The FFT size must hold the full result of correlating the recording with the sweep (without wrapping)
+	
+	for (fft_size = 1; fft_size < max_rec_length + T; fft_size <<= 1)
+		fft_size_log2++;
+	
+	x = (t_deconvolve *) malloc(sizeof(t_deconvolve));
+	
+	if (!x)
+		return 0;
+	
+	x->sweep = *sweep;
+	x->fft_size = fft_size;
+	x->fft_size_log2 = fft_size_log2;
+	x->max_rec_length = max_rec_length;
+	x->filter.realp = (double *) malloc(sizeof(double) * fft_size);
+	x->filter.imagp = x->filter.realp + (fft_size >> 1);
+	
+	sweep_buf = (double *) malloc(sizeof(double) * T);
+	
+	hisstools_create_setup_d(&x->fft_setup, fft_size_log2);
+	
+	if (!x->filter.realp || !sweep_buf || !x->fft_setup)
+	{
+		free(sweep_buf);
+		destroy_deconvolve(x);
+		return 0;
+	}
+	
+	// Sweep spectrum
+	
+	filter = x->filter;
+	
+	ess_gen(sweep, sweep_buf, 0, T);
+	hisstools_unzip_zero_d(sweep_buf, &filter, T, fft_size_log2);
+	hisstools_rfft_d(x->fft_setup, &filter, fft_size_log2);
+	
+	free(sweep_buf);
+	
+	// Find the peak power (DC and nyquist are packed into the first element)
+	
+	for (i = 1; i < (fft_size >> 1); i++)
+	{
+		power = filter.realp[i] * filter.realp[i] + filter.imagp[i] * filter.imagp[i];
+		max_power = power > max_power ? power : max_power;
+	}
+	
+	// Regularised inverse (conj(S) / (|S|^2 + beta)) with separate regularisation inside and outside the sweep range
+	// The inverse real FFT is unscaled, so the 1 / N scaling is folded into the filter
+	
+	reg_in = max_power * pow(10., reg_in_db / 10.);
+	reg_out = max_power * pow(10., reg_out_db / 10.);
+	freq_mul = sweep->sample_rate / fft_size;
+	
+	filter.realp[0] = filter.realp[0] / (filter.realp[0] * filter.realp[0] + reg_out) / fft_size;
+	filter.imagp[0] = filter.imagp[0] / (filter.imagp[0] * filter.imagp[0] + reg_out) / fft_size;
+	
+	for (i = 1; i < (fft_size >> 1); i++)
+	{
+		reg_val = (i * freq_mul < sweep->lo_f_act || i * freq_mul > sweep->hi_f_act) ? reg_out : reg_in;
+		power = filter.realp[i] * filter.realp[i] + filter.imagp[i] * filter.imagp[i];
+		
+		filter.realp[i] = filter.realp[i] / (power + reg_val) / fft_size;
+		filter.imagp[i] = -filter.imagp[i] / (power + reg_val) / fft_size;
+	}
+	
+	return x;
+}
+
+
+void destroy_deconvolve(t_deconvolve *x)
+{
+	if (x)
+	{
+		if (x->fft_setup)
+			hisstools_destroy_setup_d(x->fft_setup);
+		free(x->filter.realp);
+	}
+	
+	free(x);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+////////////////////////// Single Channel Routines ///////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+AH_Boolean deconvolve_channel(t_deconvolve *x, double *ir, double *rec, AH_UIntPtr rec_length, FFT_SPLIT_COMPLEX_D *temp)
+{
+	// The result (of fft_size samples) is circular - the linear response starts at zero and harmonic responses precede it (wrapped to the end)
+	
+	FFT_SPLIT_COMPLEX_D filter = x->filter;
+	
+	double a, b, c, d;
+	
+	AH_UIntPtr fft_size_log2 = x->fft_size_log2;
+	AH_UIntPtr i;
+	
+	if (rec_length > x->max_rec_length)
+		return false;
+	
+	hisstools_unzip_zero_d(rec, temp, rec_length, fft_size_log2);
+	hisstools_rfft_d(x->fft_setup, temp, fft_size_log2);
+	
+	// Multiply by the filter (DC and nyquist are real and packed into the first element)
+	
+	temp->realp[0] *= filter.realp[0];
+	temp->imagp[0] *= filter.imagp[0];
+	
+	for (i = 1; i < (x->fft_size >> 1); i++)
+	{
+		a = temp->realp[i];
+		b = temp->imagp[i];
+		c = filter.realp[i];
+		d = filter.imagp[i];
+		
+		temp->realp[i] = (a * c) - (b * d);
+		temp->imagp[i] = (a * d) + (b * c);
+	}
+	
+	hisstools_rifft_d(x->fft_setup, temp, fft_size_log2);
+	hisstools_zip_d(temp, ir, fft_size_log2);
+	
+	return true;
+}
+
+
+void deconvolve_extract(t_deconvolve *x, double *out, double *ir, AH_SIntPtr position, AH_UIntPtr length)
+{
+	// Copy length samples from a circular result starting at position (which may be negative)
+	
+	AH_SIntPtr fft_size = (AH_SIntPtr) x->fft_size;
+	AH_UIntPtr i;
+	
+	position %= fft_size;
+	position = position < 0 ? position + fft_size : position;
+	
+	for (i = 0; i < length; i++)
+	{
+		out[i] = ir[position++];
+		position = position == fft_size ? 0 : position;
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+////////////////////////////// Batch Routines ////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+typedef struct _deconvolve_thread
+{
+	t_deconvolve *x;
+	t_ir_post *params;
+	
+	double **outs;
+	double **recs;
+	AH_UIntPtr *rec_lengths;
+	
+	AH_UIntPtr first_chan;
+	AH_UIntPtr chan_step;
+	AH_UIntPtr num_chans;
+	
+	AH_Boolean success;
+
+} t_deconvolve_thread;
+
+
+void deconvolve_post_defaults(t_ir_post *params, AH_UIntPtr ir_length)
+{
+	params->num_harmonics = 1;
+	params->ir_length = ir_length;
+	params->pre_length = 0;
+	
+	params->trim = false;
+	params->trim_in_db = -HUGE_VAL;
+	params->trim_out_db = -90.;
+	params->trim_window_in = 1;
+	params->trim_window_out = 101;
+	
+	params->fade_in_length = 0;
+	params->fade_out_length = 0;
+	params->fade_in_type = FADE_COS;
+	params->fade_out_type = FADE_COS;
+	
+	params->normalise = false;
+	params->norm_db = 0.;
+	
+	params->max_threads = 0;
+}
+
+
+static AH_THREAD_RETURN deconvolve_thread(void *arg)
+{
+	// Deconvolve every chan_step'th channel and extract the linear / harmonic responses into the outputs
+	
+	t_deconvolve_thread *thread = (t_deconvolve_thread *) arg;
+	t_deconvolve *x = thread->x;
+	t_ir_post *params = thread->params;
+	
+	FFT_SPLIT_COMPLEX_D temp;
+	
+	double *ir = (double *) malloc(sizeof(double) * x->fft_size * 2);
+	double *out;
+	
+	AH_SIntPtr position;
+	AH_UIntPtr i, j;
+	
+	thread->success = ir ? true : false;
+	
+	if (!ir)
+		return AH_THREAD_RESULT;
+	
+	temp.realp = ir + x->fft_size;
+	temp.imagp = temp.realp + (x->fft_size >> 1);
+	
+	for (i = thread->first_chan; i < thread->num_chans; i += thread->chan_step)
+	{
+		if (deconvolve_channel(x, ir, thread->recs[i], thread->rec_lengths[i], &temp) == false)
+		{
+			thread->success = false;
+			continue;
+		}
+		
+		for (j = 0; j < params->num_harmonics; j++)
+		{
+			out = thread->outs[i] + (j * params->ir_length);
+			position = -((AH_SIntPtr) round(ess_harm_offset(&x->sweep, j + 1)) + (AH_SIntPtr) params->pre_length);
+			
+			deconvolve_extract(x, out, ir, position, params->ir_length);
+		}
+	}
+	
+	free(ir);
+	
+	return AH_THREAD_RESULT;
+}
+
+
+AH_Boolean deconvolve_batch(t_deconvolve *x, double **outs, AH_UIntPtr *out_lengths, double **recs, AH_UIntPtr *rec_lengths, AH_UIntPtr num_chans, t_ir_post *params)
+{
+	// N.B. out_lengths holds num_chans * num_harmonics values (the lengths after trimming)
+	
+	t_deconvolve_thread threads[256];
+	t_ah_thread thread_handles[256];
+	AH_Boolean started[256];
+	AH_Boolean success = true;
+	
+	double max_val = 0.;
+	double norm_mul;
+	
+	AH_UIntPtr num_harmonics = params->num_harmonics;
+	AH_UIntPtr ir_length = params->ir_length;
+	AH_UIntPtr num_threads = params->max_threads ? params->max_threads : ah_num_processors();
+	AH_UIntPtr current_start, current_end, length;
+	AH_UIntPtr i, j, k;
+	
+	num_threads = num_threads > num_chans ? num_chans : num_threads;
+	num_threads = num_threads > 256 ? 256 : num_threads;
+	
+	if (!num_chans || !num_harmonics || !ir_length)
+		return false;
+	
+	// Deconvolve (split across threads by channel - the calling thread takes the first share)
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		threads[i].x = x;
+		threads[i].params = params;
+		threads[i].outs = outs;
+		threads[i].recs = recs;
+		threads[i].rec_lengths = rec_lengths;
+		threads[i].first_chan = i;
+		threads[i].chan_step = num_threads;
+		threads[i].num_chans = num_chans;
+		threads[i].success = false;
+		
+		started[i] = i ? ah_thread_create(thread_handles + i, (t_ah_thread_routine) deconvolve_thread, threads + i) : false;
+	}
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		if (!started[i])
+			deconvolve_thread(threads + i);
+	}
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		if (started[i])
+			ah_thread_join(thread_handles[i]);
+		
+		success = threads[i].success ? success : false;
+	}
+	
+	if (success == false)
+		return false;
+	
+	// Peak across all outputs
+	
+	for (i = 0; i < num_chans; i++)
+		max_val = norm_find_max(outs[i], ir_length * num_harmonics, max_val);
+	
+	norm_mul = max_val ? 1. / max_val : 1.;
+	
+	for (j = 0; j < num_harmonics; j++)
+	{
+		// Trim (widest region found across all channels)
+		
+		current_start = 0;
+		current_end = ir_length;
+		
+		if (params->trim)
+		{
+			current_start = ir_length;
+			current_end = 0;
+			
+			for (i = 0; i < num_chans; i++)
+				trim_find_crossings_rms(outs[i] + (j * ir_length), ir_length, params->trim_window_in, params->trim_window_out, params->trim_in_db, params->trim_out_db, norm_mul, &current_start, &current_end);
+			
+			if (current_start >= current_end)
+			{
+				current_start = 0;
+				current_end = ir_length;
+			}
+			
+			current_end = current_end > ir_length ? ir_length : current_end;
+		}
+		
+		length = current_end - current_start;
+		
+		// Copy, fade and zero the remainder
+		
+		for (i = 0; i < num_chans; i++)
+		{
+			double *out = outs[i] + (j * ir_length);
+			
+			trim_copy_part(out, out, current_start, length);
+			fade_calc_fade_in(out, params->fade_in_length, length, params->fade_in_type);
+			fade_calc_fade_out(out, params->fade_out_length, length, params->fade_out_type);
+			
+			for (k = length; k < ir_length; k++)
+				out[k] = 0.;
+			
+			out_lengths[(i * num_harmonics) + j] = length;
+		}
+	}
+	
+	// Normalise
+	
+	if (params->normalise)
+	{
+		norm_mul *= pow(10., params->norm_db / 20.);
+		
+		for (i = 0; i < num_chans; i++)
+			for (k = 0; k < ir_length * num_harmonics; k++)
+				outs[i][k] *= norm_mul;
+	}
+	
+	return true;
+}
@@ -0,0 +1,83 @@
+
+
+#ifndef __HIRT_DECONVOLUTION__
+#define __HIRT_DECONVOLUTION__
+
+#include <HISSTools_FFT/HISSTools_FFT.h>
+#include <AH_Types.h>
+
+#include "HIRT_Exponential_Sweeps.h"
+#include "HIRT_Trim_Normalise.h"
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////// Deconvolve Struct ////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// The filter holds the regularised inverse spectrum of the sweep (packed real FFT format) and is read only once created
+// The FFT size is large enough that the non-causal (harmonic) part of the result does not wrap onto the linear response
+
+typedef struct _deconvolve
+{
+	FFT_SETUP_D fft_setup;
+	FFT_SPLIT_COMPLEX_D filter;
+	
+	AH_UIntPtr fft_size;
+	AH_UIntPtr fft_size_log2;
+	AH_UIntPtr max_rec_length;
+	
+	t_ess sweep;
+
+} t_deconvolve;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////// Post Processing Struct //////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Each output channel holds num_harmonics responses of ir_length samples (the linear response first, then harmonics 2, 3...)
+// Trim points are shared across channels (per harmonic) and normalisation is shared across all outputs
+
+typedef struct _ir_post
+{
+	AH_UIntPtr num_harmonics;
+	AH_UIntPtr ir_length;
+	AH_UIntPtr pre_length;
+	
+	AH_Boolean trim;
+	double trim_in_db;
+	double trim_out_db;
+	AH_UIntPtr trim_window_in;
+	AH_UIntPtr trim_window_out;
+	
+	AH_UIntPtr fade_in_length;
+	AH_UIntPtr fade_out_length;
+	t_fade_type fade_in_type;
+	t_fade_type fade_out_type;
+	
+	AH_Boolean normalise;
+	double norm_db;
+	
+	AH_UIntPtr max_threads;
+
+} t_ir_post;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////// Function Prototypes ///////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+t_deconvolve *create_deconvolve(t_ess *sweep, AH_UIntPtr max_rec_length, double reg_in_db, double reg_out_db);
+void destroy_deconvolve(t_deconvolve *x);
+
+AH_Boolean deconvolve_channel(t_deconvolve *x, double *ir, double *rec, AH_UIntPtr rec_length, FFT_SPLIT_COMPLEX_D *temp);
+void deconvolve_extract(t_deconvolve *x, double *out, double *ir, AH_SIntPtr position, AH_UIntPtr length);
+
+void deconvolve_post_defaults(t_ir_post *params, AH_UIntPtr ir_length);
+AH_Boolean deconvolve_batch(t_deconvolve *x, double **outs, AH_UIntPtr *out_lengths, double **recs, AH_UIntPtr *rec_lengths, AH_UIntPtr num_chans, t_ir_post *params);
+
+
+#endif /* __HIRT_DECONVOLUTION__ */
@@ -0,0 +1,107 @@
+
+#include "HIRT_Exponential_Sweeps.h"
+
+
+//////////////////////////////////////////////////////////////////////////
+/////////////////////////////// Parameters ///////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+AH_UIntPtr ess_params(t_ess *x, double f1, double f2, double fade_in, double fade_out, double length, double sample_rate, double amp)
+{
+	double log_ratio;
+	double L;
+	
+	// Sanity check (returns a zero length on failure)
+	
+	x->T = 0;
+	
+	if (sample_rate <= 0. || f1 <= 0. || f2 <= f1 || f2 > sample_rate / 2. || length <= 0.)
+		return 0;
+	
+	// Rate period L (rounded to a whole number of cycles of the start frequency) and the resultant length (log_ratio is the natural log of f2 / f1)
+	
+	log_ratio = log(f2 / f1);
+	L = round(f1 * length / log_ratio) / f1;
+	L = L > 0. ? L : 1. / f1;
+	
+	x->T = (AH_UIntPtr) round(L * log_ratio * sample_rate);
+	
+	// Store parameters (the phase increases as K1 * (exp(n * K2) - 1) for sample n)
+	
+	x->K1 = 2. * M_PI * f1 * L;
+	x->K2 = 1. / (L * sample_rate);
+	
+	x->lo_f_act = f1;
+	x->hi_f_act = f1 * exp(x->T * x->K2);
+	
+	x->fade_in = fade_in * sample_rate;
+	x->fade_out = fade_out * sample_rate;
+	
+	x->fade_in = x->fade_in > x->T / 2 ? x->T / 2 : x->fade_in;
+	x->fade_out = x->fade_out > x->T / 2 ? x->T / 2 : x->fade_out;
+	
+	x->sample_rate = sample_rate;
+	x->amp = amp;
+	
+	return x->T;
+}
+
+
+AH_UIntPtr ess_get_length(t_ess *x)
+{
+	return x->T;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+/////////////////////////////// Generation ///////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+AH_UIntPtr ess_gen(t_ess *x, double *out, AH_UIntPtr startN, AH_UIntPtr N)
+{
+	// Generates samples from startN (zeroing any samples past the end) and returns the number of sweep samples written
+	
+	double K1 = x->K1;
+	double K2 = x->K2;
+	double amp = x->amp;
+	double fade_in = x->fade_in;
+	double fade_out = x->fade_out;
+	double fade_val;
+	
+	AH_UIntPtr T = x->T;
+	AH_UIntPtr n, i;
+	
+	for (i = 0, n = startN; i < N && n < T; i++, n++)
+	{
+		// Raised cosine fades
+		
+		fade_val = 1.;
+		
+		if (n < fade_in)
+			fade_val = 0.5 - 0.5 * cos(M_PI * n / fade_in);
+		if ((T - n) < fade_out)
+			fade_val *= 0.5 - 0.5 * cos(M_PI * (T - n) / fade_out);
+		
+		out[i] = amp * fade_val * sin(K1 * (exp(n * K2) - 1.));
+	}
+	
+	for (n = i; n < N; n++)
+		out[n] = 0.;
+	
+	return i;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+/////////////////////////////// Harmonics ////////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+double ess_harm_offset(t_ess *x, AH_UIntPtr harm)
+{
+	// The response to harmonic harm arrives this many samples before the linear response after deconvolution
+	
+	return harm > 1 ? log((double) harm) / x->K2 : 0.;
+}
@@ -0,0 +1,50 @@
+
+
+#ifndef __HIRT_EXPONENTIAL_SWEEPS__
+#define __HIRT_EXPONENTIAL_SWEEPS__
+
+#include <AH_Win_Math.h>
+#include <AH_Types.h>
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////// Sweep Params Struct //////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// Synchronised exponential sine sweep - the rate is rounded so that the start frequency completes a whole number of cycles per
+// rate period, which keeps the phase of every harmonic aligned with the fundamental (so harmonic responses can be separated cleanly)
+
+typedef struct _ess
+{
+	double K1;
+	double K2;
+	
+	double lo_f_act;
+	double hi_f_act;
+	
+	double fade_in;
+	double fade_out;
+	
+	double sample_rate;
+	double amp;
+	
+	AH_UIntPtr T;
+
+} t_ess;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////// Function Prototypes ///////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+AH_UIntPtr ess_params(t_ess *x, double f1, double f2, double fade_in, double fade_out, double length, double sample_rate, double amp);
+
+AH_UIntPtr ess_get_length(t_ess *x);
+AH_UIntPtr ess_gen(t_ess *x, double *out, AH_UIntPtr startN, AH_UIntPtr N);
+
+double ess_harm_offset(t_ess *x, AH_UIntPtr harm);
+
+
+#endif /* __HIRT_EXPONENTIAL_SWEEPS__ */
@@ -2,14 +2,40 @@
 
 #include "HIRT_Frame_Stats.h"
 
-#ifndef __APPLE__
-#include <AH_Win_Complex_Math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <AH_Win_Complex_Math.h>
 #include <windows.h>
 #endif
 
 
+// State snapshots (native byte order) share their header layout with HISSTools_State.hpp
+
+#define FRAME_STATS_STATE_TAG 0x46535441		// 'FSTA'
+#define FRAME_STATS_STATE_VERSION 1
+
+
+typedef struct frame_stats_state
+{
+	AH_UInt32 tag;
+	AH_UInt32 version;
+	AH_UInt64 size;
+	
+	double alpha_u;
+	double alpha_d;
+	
+	AH_UInt64 frames;
+	AH_UInt64 last_N;
+	
+	AH_UInt32 max_age;
+	AH_UInt32 mode;
+
+} t_frame_stats_state;
+
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////// Create / Destroy ////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -265,3 +291,80 @@ void frame_stats_read(t_frame_stats *stats, float *out, AH_UIntPtr N)
 	}
 }
 
+
+//////////////////////////////////////////////////////////////////////////
+///////////////////////////// Save / Restore /////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+AH_UIntPtr frame_stats_state_size(t_frame_stats *stats)
+{
+	// Only the part of the frame in use is stored
+	
+	return sizeof(t_frame_stats_state) + stats->last_N * (sizeof(double) + sizeof(AH_UInt32));
+}
+
+
+AH_Boolean frame_stats_save_state(t_frame_stats *stats, void *data, AH_UIntPtr size)
+{
+	t_frame_stats_state state;
+	AH_UIntPtr N = stats->last_N;
+	unsigned char *out = (unsigned char *) data;
+	
+	if (!data || size < frame_stats_state_size(stats))
+		return false;
+	
+	state.tag = FRAME_STATS_STATE_TAG;
+	state.version = FRAME_STATS_STATE_VERSION;
+	state.size = frame_stats_state_size(stats);
+	state.alpha_u = stats->alpha_u;
+	state.alpha_d = stats->alpha_d;
+	state.frames = stats->frames;
+	state.last_N = N;
+	state.max_age = stats->max_age;
+	state.mode = (AH_UInt32) stats->mode;
+	
+	memcpy(out, &state, sizeof(t_frame_stats_state));
+	out += sizeof(t_frame_stats_state);
+	memcpy(out, stats->current_frame, N * sizeof(double));
+	out += N * sizeof(double);
+	memcpy(out, stats->ages, N * sizeof(AH_UInt32));
+	
+	return true;
+}
+
+
+AH_Boolean frame_stats_restore_state(t_frame_stats *stats, const void *data, AH_UIntPtr size)
+{
+	// The stats are left unchanged if the state is not valid (or does not fit)
+	
+	t_frame_stats_state state;
+	const unsigned char *in = (const unsigned char *) data;
+	AH_UIntPtr N;
+	
+	if (!data || size < sizeof(t_frame_stats_state))
+		return false;
+	
+	memcpy(&state, in, sizeof(t_frame_stats_state));
+	in += sizeof(t_frame_stats_state);
+	N = (AH_UIntPtr) state.last_N;
+	
+	if (state.tag != FRAME_STATS_STATE_TAG || state.version != FRAME_STATS_STATE_VERSION || state.mode > MODE_ACCUMULATE)
+		return false;
+	
+	if (N > stats->max_N || state.size != sizeof(t_frame_stats_state) + N * (sizeof(double) + sizeof(AH_UInt32)) || size < state.size)
+		return false;
+	
+	stats->alpha_u = state.alpha_u;
+	stats->alpha_d = state.alpha_d;
+	stats->frames = (AH_UIntPtr) state.frames;
+	stats->last_N = N;
+	stats->max_age = state.max_age;
+	stats->mode = (t_frame_mode) state.mode;
+	
+	memcpy(stats->current_frame, in, N * sizeof(double));
+	in += N * sizeof(double);
+	memcpy(stats->ages, in, N * sizeof(AH_UInt32));
+	
+	return true;
+}
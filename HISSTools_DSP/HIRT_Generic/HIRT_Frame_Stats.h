@@ -61,5 +61,9 @@ void frame_stats_alpha(t_frame_stats *stats, double alpha_u, double alpha_d);
 void frame_stats_write(t_frame_stats *stats, float *in, AH_UIntPtr N);
 void frame_stats_read(t_frame_stats *stats, float *out, AH_UIntPtr N);
 
+AH_UIntPtr frame_stats_state_size(t_frame_stats *stats);
+AH_Boolean frame_stats_save_state(t_frame_stats *stats, void *data, AH_UIntPtr size);
+AH_Boolean frame_stats_restore_state(t_frame_stats *stats, const void *data, AH_UIntPtr size);
+
 
 #endif /*__HIRT_FRAME_STATS_ */
\ No newline at end of file
@@ -0,0 +1,387 @@
+
+#include "HIRT_Inverse_Filter.h"
+
+#include <AH_Threads.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+//////////////////////////////////////////////////////////////////////////
+///////////////////////////// Regularisation /////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+double inverse_filter_reg_db(double *reg_curve, AH_UIntPtr num_points, double freq)
+{
+	double lo_f, hi_f, interp;
+	
+	AH_UIntPtr i;
+	
+	if (!num_points)
+		return -HUGE_VAL;
+	
+	// Hold the end values
+	
+	if (freq <= reg_curve[0] || num_points == 1)
+		return reg_curve[1];
+	
+	if (freq >= reg_curve[(num_points - 1) * 2])
+		return reg_curve[(num_points - 1) * 2 + 1];
+	
+	// Interpolate in log frequency
+	
+	for (i = 1; i < num_points - 1; i++)
+		if (freq < reg_curve[i * 2])
+			break;
+	
+	lo_f = reg_curve[(i - 1) * 2];
+	hi_f = reg_curve[i * 2];
+	interp = (lo_f > 0. && hi_f > lo_f) ? log(freq / lo_f) / log(hi_f / lo_f) : 1.;
+	
+	return reg_curve[(i - 1) * 2 + 1] + interp * (reg_curve[i * 2 + 1] - reg_curve[(i - 1) * 2 + 1]);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+////////////////////////////// Thread Struct /////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+typedef enum {
+
+	INVERSE_STAGE_FORWARD = 0,
+	INVERSE_STAGE_SOLVE = 1,
+	INVERSE_STAGE_INVERSE = 2,
+
+} t_inverse_stage;
+
+
+typedef struct _inverse_thread
+{
+	t_inverse_filter_params *params;
+	t_inverse_stage stage;
+	
+	FFT_SETUP_D fft_setup;
+	
+	double **filters;
+	double **irs;
+	AH_UIntPtr ir_length;
+	
+	double gram_max;
+	
+	AH_UIntPtr start;
+	AH_UIntPtr end;
+	
+	long failed_bins;
+
+} t_inverse_thread;
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////// Per Bin Solve ///////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+static AH_Boolean inverse_filter_solve_bin(t_inverse_thread *thread, t_matrix_complex **matrices, AH_UIntPtr k, AH_Boolean nyquist)
+{
+	// N.B. DC and nyquist are real and packed into the first element (the nyquist is stored in the imaginary part)
+	
+	t_inverse_filter_params *params = thread->params;
+	
+	t_matrix_complex *h = matrices[0];
+	t_matrix_complex *hh = matrices[1];
+	t_matrix_complex *gram = matrices[2];
+	t_matrix_complex *decomposed = matrices[3];
+	t_matrix_complex *g = matrices[4];
+	
+	double **filters = thread->filters;
+	double *buf;
+	
+	AH_UIntPtr num_outs = params->num_outs;
+	AH_UIntPtr num_ins = params->num_ins;
+	AH_UIntPtr fft_size = (AH_UIntPtr) 1 << params->fft_size_log2;
+	AH_UIntPtr half = fft_size >> 1;
+	AH_UIntPtr real_idx = nyquist ? half : k;
+	AH_UIntPtr imag_idx = half + k;
+	AH_UIntPtr m, n;
+	
+	double freq = nyquist ? params->sample_rate / 2. : (k * params->sample_rate) / fft_size;
+	double beta = thread->gram_max * pow(10., inverse_filter_reg_db(params->reg_curve, params->reg_num_points, freq) / 10.);
+	
+	COMPLEX_DOUBLE val;
+	COMPLEX_DOUBLE rotate;
+	
+	AH_Boolean success = true;
+	
+	MATRIX_REF_COMPLEX(h)
+	MATRIX_REF_COMPLEX(gram)
+	MATRIX_REF_COMPLEX(g)
+	
+	// Modelling delay and scaling (forward real FFTs are scaled by two and inverse transforms are unscaled)
+	// N.B. only a real value is stored at nyquist, so the delay is rounded to whole samples there (the rotation is then +/-1)
+	
+	if (nyquist)
+		rotate = CPOLAR(2. / fft_size, -M_PI * round(params->delay));
+	else
+		rotate = CPOLAR(2. / fft_size, -2. * M_PI * k * params->delay / fft_size);
+	
+	// Read the measured responses
+	
+	matrix_new_size_complex(h, num_outs, num_ins);
+	
+	MATRIX_DEREF(h)
+	
+	for (m = 0; m < num_outs; m++)
+	{
+		for (n = 0; n < num_ins; n++)
+		{
+			buf = filters[m * num_ins + n];
+			MATRIX_ELEMENT(h, m, n) = k ? CSET(buf[k], buf[imag_idx]) : CSET(buf[real_idx], 0);
+		}
+	}
+	
+	// Form the regularised Gram matrix (H^H H + beta I) and solve for G
+	
+	matrix_conjugate_transpose_complex(hh, h);
+	matrix_multiply_complex(gram, hh, h);
+	
+	MATRIX_DEREF(gram)
+	
+	for (n = 0; n < num_ins; n++)
+		MATRIX_ELEMENT(gram, n, n) = CADD(MATRIX_ELEMENT(gram, n, n), CSET(beta, 0));
+	
+	if (matrix_choelsky_decompose_complex(decomposed, gram))
+		success = false;
+	else
+		matrix_choelsky_solve_complex(g, decomposed, hh);
+	
+	// Write the filters (zeroed if the system could not be solved)
+	
+	MATRIX_DEREF(g)
+	
+	for (n = 0; n < num_ins; n++)
+	{
+		for (m = 0; m < num_outs; m++)
+		{
+			buf = filters[n * num_outs + m];
+			val = success ? CMUL(MATRIX_ELEMENT(g, n, m), rotate) : CSET(0, 0);
+			
+			buf[real_idx] = CREAL(val);
+			
+			if (k)
+				buf[imag_idx] = CIMAG(val);
+		}
+	}
+	
+	return success;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////// Thread Routine //////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+static AH_THREAD_RETURN inverse_filter_thread(void *arg)
+{
+	t_inverse_thread *thread = (t_inverse_thread *) arg;
+	t_inverse_filter_params *params = thread->params;
+	t_matrix_complex *matrices[5];
+	
+	FFT_SPLIT_COMPLEX_D spectrum;
+	
+	AH_UIntPtr fft_size_log2 = params->fft_size_log2;
+	AH_UIntPtr fft_size = (AH_UIntPtr) 1 << fft_size_log2;
+	AH_UIntPtr num_outs = params->num_outs;
+	AH_UIntPtr num_ins = params->num_ins;
+	AH_UIntPtr i;
+	
+	double *temp;
+	
+	switch (thread->stage)
+	{
+		case INVERSE_STAGE_FORWARD:
+		
+			// Transform the responses in place into the filter memory (in packed split format)
+			
+			for (i = thread->start; i < thread->end; i++)
+			{
+				spectrum.realp = thread->filters[i];
+				spectrum.imagp = spectrum.realp + (fft_size >> 1);
+				
+				hisstools_unzip_zero_d(thread->irs[i], &spectrum, thread->ir_length, fft_size_log2);
+				hisstools_rfft_d(thread->fft_setup, &spectrum, fft_size_log2);
+			}
+			break;
+		
+		case INVERSE_STAGE_SOLVE:
+		
+			// Solve a contiguous range of bins (each bin is read completely before it is overwritten)
+			
+			matrices[0] = matrix_alloc_complex(num_outs, num_ins);
+			matrices[1] = matrix_alloc_complex(num_ins, num_outs);
+			matrices[2] = matrix_alloc_complex(num_ins, num_ins);
+			matrices[3] = matrix_alloc_complex(num_ins, num_ins);
+			matrices[4] = matrix_alloc_complex(num_ins, num_outs);
+			
+			for (i = 0; i < 5; i++)
+				if (!matrices[i])
+					thread->failed_bins = -1;
+			
+			for (i = thread->start; i < thread->end && thread->failed_bins >= 0; i++)
+			{
+				if (inverse_filter_solve_bin(thread, matrices, i, false) == false)
+					thread->failed_bins++;
+				if (!i && inverse_filter_solve_bin(thread, matrices, i, true) == false)
+					thread->failed_bins++;
+			}
+			
+			for (i = 0; i < 5; i++)
+				if (matrices[i])
+					matrix_destroy_complex(matrices[i]);
+			break;
+		
+		case INVERSE_STAGE_INVERSE:
+		
+			// Transform the filters back to the time domain
+			
+			temp = (double *) malloc(sizeof(double) * fft_size);
+			
+			if (!temp)
+			{
+				thread->failed_bins = -1;
+				break;
+			}
+			
+			for (i = thread->start; i < thread->end; i++)
+			{
+				spectrum.realp = thread->filters[i];
+				spectrum.imagp = spectrum.realp + (fft_size >> 1);
+				
+				hisstools_rifft_d(thread->fft_setup, &spectrum, fft_size_log2);
+				hisstools_zip_d(&spectrum, temp, fft_size_log2);
+				
+				memcpy(thread->filters[i], temp, sizeof(double) * fft_size);
+			}
+			
+			free(temp);
+			break;
+	}
+	
+	return AH_THREAD_RESULT;
+}
+
+
+static void inverse_filter_run_stage(t_inverse_thread *threads, AH_UIntPtr num_threads, t_inverse_stage stage, AH_UIntPtr num_items)
+{
+	// Split the items into contiguous ranges (the calling thread takes the first range)
+	
+	t_ah_thread thread_handles[256];
+	AH_Boolean started[256];
+	
+	AH_UIntPtr i;
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		threads[i].stage = stage;
+		threads[i].start = (num_items * i) / num_threads;
+		threads[i].end = (num_items * (i + 1)) / num_threads;
+		
+		started[i] = i ? ah_thread_create(thread_handles + i, (t_ah_thread_routine) inverse_filter_thread, threads + i) : false;
+	}
+	
+	for (i = 0; i < num_threads; i++)
+		if (!started[i])
+			inverse_filter_thread(threads + i);
+	
+	for (i = 0; i < num_threads; i++)
+		if (started[i])
+			ah_thread_join(thread_handles[i]);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//////////////////////////////// Calculation /////////////////////////////
+//////////////////////////////////////////////////////////////////////////
+
+
+long inverse_filter_calc(double **filters, double **irs, AH_UIntPtr ir_length, t_inverse_filter_params *params)
+{
+	// Each filter must hold 2 ^ fft_size_log2 samples - returns the number of bins that could not be solved (or -1 on failure)
+	
+	t_inverse_thread threads[256];
+	FFT_SETUP_D fft_setup;
+	
+	double gram_max = 0.;
+	double diag, *buf;
+	
+	AH_UIntPtr fft_size = (AH_UIntPtr) 1 << params->fft_size_log2;
+	AH_UIntPtr half = fft_size >> 1;
+	AH_UIntPtr num_outs = params->num_outs;
+	AH_UIntPtr num_ins = params->num_ins;
+	AH_UIntPtr num_threads = params->max_threads ? params->max_threads : ah_num_processors();
+	AH_UIntPtr i, k, m, n;
+	
+	long failed_bins = 0;
+	
+	num_threads = num_threads > half ? half : num_threads;
+	num_threads = num_threads > 256 ? 256 : num_threads;
+	
+	if (!num_outs || !num_ins || ir_length > fft_size || fft_size < 4)
+		return -1;
+	
+	hisstools_create_setup_d(&fft_setup, params->fft_size_log2);
+	
+	if (!fft_setup)
+		return -1;
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		threads[i].params = params;
+		threads[i].fft_setup = fft_setup;
+		threads[i].filters = filters;
+		threads[i].irs = irs;
+		threads[i].ir_length = ir_length;
+		threads[i].failed_bins = 0;
+	}
+	
+	// Forward transforms (by response)
+	
+	inverse_filter_run_stage(threads, num_threads, INVERSE_STAGE_FORWARD, num_outs * num_ins);
+	
+	// Find the peak of the Gram matrix diagonal (the regularisation reference)
+	
+	for (n = 0; n < num_ins; n++)
+	{
+		for (k = 0; k < half; k++)
+		{
+			for (m = 0, diag = 0.; m < num_outs; m++)
+			{
+				buf = filters[m * num_ins + n];
+				diag += k ? buf[k] * buf[k] + buf[half + k] * buf[half + k] : buf[0] * buf[0];
+			}
+			
+			gram_max = diag > gram_max ? diag : gram_max;
+		}
+	}
+	
+	for (i = 0; i < num_threads; i++)
+		threads[i].gram_max = gram_max;
+	
+	// Solve (by bin) and inverse transforms (by filter)
+	
+	inverse_filter_run_stage(threads, num_threads, INVERSE_STAGE_SOLVE, half);
+	inverse_filter_run_stage(threads, num_threads, INVERSE_STAGE_INVERSE, num_outs * num_ins);
+	
+	hisstools_destroy_setup_d(fft_setup);
+	
+	for (i = 0; i < num_threads; i++)
+	{
+		if (threads[i].failed_bins < 0)
+			return -1;
+		
+		failed_bins += threads[i].failed_bins;
+	}
+	
+	return failed_bins;
+}
@@ -0,0 +1,53 @@
+
+
+#ifndef __HIRT_INVERSE_FILTER__
+#define __HIRT_INVERSE_FILTER__
+
+#include <HISSTools_FFT/HISSTools_FFT.h>
+#include <AH_Types.h>
+
+#include "HIRT_Matrix_Math.h"
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////// Inverse Filter Params ///////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+// MIMO inverse filters are designed per bin as G = (H^H H + beta(f) I)^-1 H^H, delayed by the modelling delay (in samples)
+// The delay may be fractional, but it is rounded to whole samples at nyquist (where the response must be real), so only integer delays are exact
+//
+// H is the num_outs x num_ins matrix of measured responses (irs[out * num_ins + in] is the response from input in to output out)
+// G is the num_ins x num_outs matrix of filters (filters[in * num_outs + out] feeds input in from target signal out)
+//
+// The regularisation curve is given as pairs of frequency (Hz) and level (dB relative to the peak of the Gram matrix diagonal)
+// Levels are interpolated in log frequency and held constant beyond the first and last points
+
+typedef struct _inverse_filter_params
+{
+	AH_UIntPtr num_outs;
+	AH_UIntPtr num_ins;
+	AH_UIntPtr fft_size_log2;
+	
+	double sample_rate;
+	double delay;
+	
+	double *reg_curve;
+	AH_UIntPtr reg_num_points;
+	
+	AH_UIntPtr max_threads;
+
+} t_inverse_filter_params;
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////// Function Prototypes ///////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+
+double inverse_filter_reg_db(double *reg_curve, AH_UIntPtr num_points, double freq);
+
+long inverse_filter_calc(double **filters, double **irs, AH_UIntPtr ir_length, t_inverse_filter_params *params);
+
+
+#endif /* __HIRT_INVERSE_FILTER__ */
@@ -168,7 +168,7 @@ void matrix_choelsky_solve_complex (t_matrix_complex *out, t_matrix_complex *dec
 {
 	AH_UIntPtr m_dim = solve->m_dim;
 	AH_UIntPtr n_dim = solve->n_dim;
-	AH_UIntPtr i, j, k;
+	AH_UIntPtr i, j, k, l;
 	
 	COMPLEX_DOUBLE sum;
 	
@@ -201,8 +201,10 @@ void matrix_choelsky_solve_complex (t_matrix_complex *out, t_matrix_complex *dec
 		
 		// Solve LT.x = y (backward substitution)
 
-		for (j = m_dim - 1; j >= 0; j--)
+		for (l = m_dim; l > 0; l--)
 		{		
+			j = l - 1;
+			
 			for (sum = MATRIX_ELEMENT(out, j, i), k = j + 1; k < m_dim; k++)
 				sum = CSUB(sum, CMUL(CONJ(MATRIX_ELEMENT(decompose, k, j)), MATRIX_ELEMENT(out, k, i)));
 		
@@ -2,9 +2,10 @@
 #ifndef __HIRT_MATRIX_MATH__
 #define __HIRT_MATRIX_MATH__
 
-#ifndef __APPLE__
 #include <stdio.h>
 #include <stdlib.h>
+
+#ifdef _WIN32
 #include <windows.h>
 #endif
 
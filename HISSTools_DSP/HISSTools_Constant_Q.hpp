@@ -0,0 +1,385 @@
+
+
+#ifndef __HISSTOOLS_CONSTANT_Q__
+#define __HISSTOOLS_CONSTANT_Q__
+
+
+#include "HISSTools_FFT.hpp"
+#include "HISSTools_Frame.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HISSTOOLS_CONSTANT_Q_SSE2
+#endif
+
+
+// Streaming constant-Q (or variable-Q) transform using the sparse spectral kernel method (Brown and Puckette)
+//
+// Each bin has a Hann windowed complex exponential kernel of length samplingRate / (alpha * f + gamma), where alpha = 2^(1/binsPerOctave) - 1
+// With a gamma of zero the Q is constant - a positive gamma (in Hz) widens the low bins (variable-Q) so that they respond faster
+//
+// The kernels are centred in a power of two frame and transformed once (when the kernel is set)
+// Spectral kernel values are stored in compressed rows - each row holds the contiguous run of FFT bins between the first and last values
+// above the threshold (relative to the row peak), so the product with each frame spectrum runs over contiguous memory
+//
+// Coefficients are passed to processCQ() for each frame and correspond to the centre of the frame
+
+
+class HISSTools_Constant_Q : public HISSTools_Frame, protected HISSTools_FFT, protected HISSTools_FSpectrum
+{
+
+public:
+
+	HISSTools_Constant_Q(unsigned long maxFFTSize) : HISSTools_Frame(maxFFTSize, 1), HISSTools_FFT(maxFFTSize), HISSTools_FSpectrum(maxFFTSize, kSpectrumComplex)
+	{
+		mMaxFFTSize = maxFFTSize;
+		mFFTSize = 0;
+		mHopSize = 512.0;
+		mSamplingRate = 44100.0;
+		mNBins = 0;
+		
+		mRowStarts = NULL;
+		mRowColumns = NULL;
+		mKernelReal = NULL;
+		mKernelImag = NULL;
+		mFrequencies = NULL;
+		mCQReal = NULL;
+		mCQImag = NULL;
+	}
+	
+	~HISSTools_Constant_Q()
+	{
+		freeKernel();
+	}
+
+
+private:
+
+	void freeKernel()
+	{
+		delete[] mRowStarts;
+		delete[] mRowColumns;
+		delete[] mKernelReal;
+		delete[] mKernelImag;
+		delete[] mFrequencies;
+		delete[] mCQReal;
+		delete[] mCQImag;
+		
+		mRowStarts = NULL;
+		mRowColumns = NULL;
+		mKernelReal = NULL;
+		mKernelImag = NULL;
+		mFrequencies = NULL;
+		mCQReal = NULL;
+		mCQImag = NULL;
+		mNBins = 0;
+	}
+	
+	
+	bool kernelSpectrum(double *real, double *imag, double *temp, double frequency, double length)
+	{
+		// Spectrum of a Hann windowed complex exponential (normalised by its length) centred in the frame
+		// The complex kernel is transformed as two real FFTs (real and imaginary parts) which are then combined
+		
+		FFT_SPLIT_COMPLEX_D FFTData = *getSpectrum();
+		
+		unsigned long FFTSize = mFFTSize;
+		unsigned long nColumns = (FFTSize >> 1) + 1;
+		double start = (FFTSize - length) * 0.5;
+		unsigned long i;
+		
+		for (unsigned long part = 0; part < 2; part++)
+		{
+			for (i = 0; i < FFTSize; i++)
+			{
+				double position = i - start;
+				double window = (position >= 0.0 && position < length) ? (0.5 - 0.5 * cos(2.0 * M_PI * position / length)) / length : 0.0;
+				double phase = 2.0 * M_PI * frequency * ((double) i - (double) (FFTSize >> 1)) / mSamplingRate;
+				
+				temp[i] = window * (part ? sin(phase) : cos(phase));
+			}
+			
+			if (timeToSpectrum(temp, this, FFTSize, FFTSize, mSamplingRate) == FALSE)
+				return FALSE;
+			
+			// K = A + iB (where A and B are the spectra of the real and imaginary parts)
+			
+			for (i = 0; i < nColumns; i++)
+			{
+				if (part)
+				{
+					real[i] -= FFTData.imagp[i];
+					imag[i] += FFTData.realp[i];
+				}
+				else
+				{
+					real[i] = FFTData.realp[i];
+					imag[i] = FFTData.imagp[i];
+				}
+			}
+		}
+		
+		return TRUE;
+	}
+	
+	
+	static void kernelProduct(const double *kernelReal, const double *kernelImag, const double *real, const double *imag, unsigned long size, double *outReal, double *outImag)
+	{
+		// Complex dot product of a kernel row with the frame spectrum
+		
+		double sumReal = 0.0;
+		double sumImag = 0.0;
+		unsigned long i = 0;
+
+#ifdef HISSTOOLS_CONSTANT_Q_SSE2
+		__m128d accReal = _mm_setzero_pd();
+		__m128d accImag = _mm_setzero_pd();
+		
+		for (; i + 2 <= size; i += 2)
+		{
+			__m128d kr = _mm_loadu_pd(kernelReal + i);
+			__m128d ki = _mm_loadu_pd(kernelImag + i);
+			__m128d xr = _mm_loadu_pd(real + i);
+			__m128d xi = _mm_loadu_pd(imag + i);
+			
+			accReal = _mm_add_pd(accReal, _mm_sub_pd(_mm_mul_pd(xr, kr), _mm_mul_pd(xi, ki)));
+			accImag = _mm_add_pd(accImag, _mm_add_pd(_mm_mul_pd(xr, ki), _mm_mul_pd(xi, kr)));
+		}
+		
+		double lanes[2];
+		
+		_mm_storeu_pd(lanes, accReal);
+		sumReal = lanes[0] + lanes[1];
+		_mm_storeu_pd(lanes, accImag);
+		sumImag = lanes[0] + lanes[1];
+#endif
+
+		for (; i < size; i++)
+		{
+			sumReal += real[i] * kernelReal[i] - imag[i] * kernelImag[i];
+			sumImag += real[i] * kernelImag[i] + imag[i] * kernelReal[i];
+		}
+		
+		*outReal = sumReal;
+		*outImag = sumImag;
+	}
+
+
+protected:
+
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *getSpectrum();
+		
+		// Check that the frame size matches the kernel
+		
+		if (!mNBins || frameSize != mFFTSize)
+			return;
+		
+		if (timeToSpectrum(iFrame, this, frameSize, frameSize, mSamplingRate) == FALSE)
+			return;
+		
+		// Sparse matrix-vector product (one contiguous run per row)
+		
+		for (unsigned long i = 0; i < mNBins; i++)
+		{
+			unsigned long start = mRowStarts[i];
+			unsigned long column = mRowColumns[i];
+			
+			kernelProduct(mKernelReal + start, mKernelImag + start, FFTData.realp + column, FFTData.imagp + column, mRowStarts[i + 1] - start, mCQReal + i, mCQImag + i);
+		}
+		
+		processCQ(mCQReal, mCQImag, mNBins);
+	}
+	
+	
+	void virtual processCQ(const double *real, const double *imag, unsigned long nBins)
+	{
+		// This function should be overridden to receive the (complex) coefficients for each frame (lowest bin first)
+	}
+
+
+public:
+
+	bool setKernel(double fMin, double fMax, unsigned long binsPerOctave, double samplingRate, double gamma = 0.0, double thresholdDB = -60.0)
+	{
+		// Bins run from fMin up to fMax (limited to the Nyquist) - the longest kernel must fit in the maximum FFT size
+		// N.B. this allocates memory and is not threadsafe
+		
+		freeKernel();
+		
+		if (fMin <= 0.0 || fMax < fMin || !binsPerOctave || samplingRate <= 0.0)
+			return FALSE;
+		
+		fMax = std::min(fMax, samplingRate * 0.5);
+		
+		double alpha = pow(2.0, 1.0 / binsPerOctave) - 1.0;
+		double threshold = pow(10.0, thresholdDB / 20.0);
+		double maxLength = samplingRate / (alpha * fMin + std::max(0.0, gamma));
+		
+		unsigned long nBins = (unsigned long) floor(binsPerOctave * log2(fMax / fMin) + 1e-9) + 1;
+		unsigned long FFTSize = 4;
+		unsigned long i, j;
+		
+		while (FFTSize < maxLength)
+			FFTSize <<= 1;
+		
+		if (FFTSize > mMaxFFTSize)
+			return FALSE;
+		
+		mFFTSize = FFTSize;
+		mSamplingRate = samplingRate;
+		
+		unsigned long nColumns = (FFTSize >> 1) + 1;
+		
+		double *real = new double[nColumns];
+		double *imag = new double[nColumns];
+		double *temp = new double[FFTSize];
+		
+		unsigned long *firsts = new unsigned long[nBins];
+		unsigned long *lasts = new unsigned long[nBins];
+		
+		mFrequencies = new double[nBins];
+		
+		// First pass - find the run of each row above the threshold
+		
+		unsigned long nValues = 0;
+		bool success = TRUE;
+		
+		for (i = 0; i < nBins && success == TRUE; i++)
+		{
+			double peak = 0.0;
+			
+			mFrequencies[i] = fMin * pow(2.0, (double) i / binsPerOctave);
+			success = kernelSpectrum(real, imag, temp, mFrequencies[i], samplingRate / (alpha * mFrequencies[i] + std::max(0.0, gamma)));
+			
+			for (j = 0; j < nColumns; j++)
+				peak = std::max(peak, real[j] * real[j] + imag[j] * imag[j]);
+			
+			peak = peak * threshold * threshold;
+			
+			for (firsts[i] = 0; firsts[i] < nColumns - 1 && real[firsts[i]] * real[firsts[i]] + imag[firsts[i]] * imag[firsts[i]] < peak; firsts[i]++);
+			for (lasts[i] = nColumns - 1; lasts[i] > firsts[i] && real[lasts[i]] * real[lasts[i]] + imag[lasts[i]] * imag[lasts[i]] < peak; lasts[i]--);
+			
+			nValues += lasts[i] - firsts[i] + 1;
+		}
+		
+		// Second pass - store the conjugate kernels (scaled by the FFT size, so that the product gives the inner product with the kernel)
+		
+		if (success == TRUE)
+		{
+			mRowStarts = new unsigned long[nBins + 1];
+			mRowColumns = new unsigned long[nBins];
+			mKernelReal = new double[nValues];
+			mKernelImag = new double[nValues];
+			mCQReal = new double[nBins];
+			mCQImag = new double[nBins];
+			
+			mRowStarts[0] = 0;
+			
+			for (i = 0; i < nBins && success == TRUE; i++)
+			{
+				success = kernelSpectrum(real, imag, temp, mFrequencies[i], samplingRate / (alpha * mFrequencies[i] + std::max(0.0, gamma)));
+				
+				mRowColumns[i] = firsts[i];
+				mRowStarts[i + 1] = mRowStarts[i] + lasts[i] - firsts[i] + 1;
+				
+				for (j = firsts[i]; j <= lasts[i]; j++)
+				{
+					mKernelReal[mRowStarts[i] + j - firsts[i]] = real[j] / FFTSize;
+					mKernelImag[mRowStarts[i] + j - firsts[i]] = -imag[j] / FFTSize;
+				}
+			}
+			
+			mNBins = nBins;
+		}
+		
+		delete[] real;
+		delete[] imag;
+		delete[] temp;
+		delete[] firsts;
+		delete[] lasts;
+		
+		if (success == FALSE)
+		{
+			freeKernel();
+			return FALSE;
+		}
+		
+		HISSTools_Frame::setParams(mFFTSize, mHopSize, TRUE);
+		
+		return TRUE;
+	}
+	
+	
+	void setHopSize(double hopSize)
+	{
+		mHopSize = std::max(1.0, hopSize);
+		
+		if (mFFTSize)
+			HISSTools_Frame::setParams(mFFTSize, mHopSize, TRUE);
+	}
+	
+	
+	unsigned long getNBins()
+	{
+		return mNBins;
+	}
+	
+	
+	double getFrequency(unsigned long bin)
+	{
+		return bin < mNBins ? mFrequencies[bin] : 0.0;
+	}
+	
+	
+	unsigned long getFFTSize()
+	{
+		return mFFTSize;
+	}
+	
+	
+	unsigned long getKernelSize()
+	{
+		// Number of stored kernel values (over all rows)
+		
+		return mNBins ? mRowStarts[mNBins] : 0;
+	}
+	
+	
+	unsigned long getLatency()
+	{
+		return mFFTSize >> 1;
+	}
+
+
+private:
+
+	// Kernel (compressed rows)
+	
+	unsigned long *mRowStarts;
+	unsigned long *mRowColumns;
+	double *mKernelReal;
+	double *mKernelImag;
+	double *mFrequencies;
+	
+	// Output
+	
+	double *mCQReal;
+	double *mCQImag;
+	
+	// Parameters
+	
+	double mHopSize;
+	double mSamplingRate;
+	
+	unsigned long mFFTSize;
+	unsigned long mNBins;
+	
+	// Maximums
+	
+	unsigned long mMaxFFTSize;
+};
+
+
+#endif
@@ -0,0 +1,280 @@
+
+
+#ifndef __HISSTOOLS_DPSS__
+#define __HISSTOOLS_DPSS__
+
+
+#include <cmath>
+#include <algorithm>
+#include "../HISSTools_Utility/HISSTools_ThreadSafety.hpp"
+
+
+// Discrete Prolate Spheroidal Sequences (Slepian tapers)
+//
+// Tapers are found as the eigenvectors of the symmetric tridiagonal matrix that commutes with the concentration problem
+// Eigenvalues are found by bisection (using Sturm sequence counts) and eigenvectors by inverse iteration
+// Each block holds K unit energy tapers of length N, followed by the K concentration ratios (lambda)
+//
+// Calculation allocates and is O(N^2) per taper (for the concentration ratios) so prepare() should be called off the audio thread
+// Results are cached and shared, so that find() can retrieve them without calculation or allocation
+
+
+class HISSTools_DPSS
+{
+
+public:
+
+	static const unsigned long kMaxTapers = 16;
+	
+	
+	static HISSTools_RefPtr<double> prepare(unsigned long N, double NW, unsigned long K)
+	{
+		HISSTools_RefPtr<double> tapers = find(N, NW, K);
+		
+		if (tapers.getSize() || !N || !K || K > kMaxTapers || K > N || NW <= 0.0 || NW >= N * 0.5)
+			return tapers;
+		
+		tapers = HISSTools_RefPtr<double>(K * (N + 1));
+		
+		calculate(tapers.get(), N, NW, K);
+		
+		// Store in the cache (replacing the oldest entry if full)
+		
+		Cache& cache = getCache();
+		
+		cache.mLock.acquire();
+		
+		Cache::Entry& entry = cache.mEntries[cache.mNext];
+		
+		entry.mTapers = tapers;
+		entry.mN = N;
+		entry.mNW = NW;
+		entry.mK = K;
+		
+		cache.mNext = (cache.mNext + 1) % Cache::kNumEntries;
+		cache.mLock.release();
+		
+		return tapers;
+	}
+	
+	
+	static HISSTools_RefPtr<double> find(unsigned long N, double NW, unsigned long K)
+	{
+		HISSTools_RefPtr<double> tapers;
+		Cache& cache = getCache();
+		
+		cache.mLock.acquire();
+		
+		for (unsigned long i = 0; i < Cache::kNumEntries; i++)
+		{
+			Cache::Entry& entry = cache.mEntries[i];
+			
+			if (entry.mN == N && entry.mNW == NW && entry.mK == K && entry.mTapers.getSize())
+			{
+				tapers = entry.mTapers;
+				break;
+			}
+		}
+		
+		cache.mLock.release();
+		
+		return tapers;
+	}
+
+
+private:
+
+	struct Cache
+	{
+		static const unsigned long kNumEntries = 32;
+		
+		struct Entry
+		{
+			Entry() : mN(0), mNW(0.0), mK(0) {}
+			
+			HISSTools_RefPtr<double> mTapers;
+			unsigned long mN;
+			double mNW;
+			unsigned long mK;
+		};
+		
+		Cache() : mNext(0) {}
+		
+		Entry mEntries[kNumEntries];
+		unsigned long mNext;
+		HISSTools_SpinLock mLock;
+	};
+	
+	
+	static Cache& getCache()
+	{
+		static Cache cache;
+		
+		return cache;
+	}
+	
+	
+	static unsigned long countBelow(double *diag, double *offSq, unsigned long N, double x)
+	{
+		// Sturm sequence count of the eigenvalues less than x
+		
+		unsigned long count = 0;
+		double q = diag[0] - x;
+		
+		if (q < 0.0)
+			count++;
+		
+		for (unsigned long i = 1; i < N; i++)
+		{
+			q = (q == 0.0) ? 1e-300 : q;
+			q = diag[i] - x - offSq[i] / q;
+			
+			if (q < 0.0)
+				count++;
+		}
+		
+		return count;
+	}
+	
+	
+	static void inverseIteration(double *vector, double *diag, double *off, double *work, unsigned long N, double eigenvalue)
+	{
+		// Solve (T - eigenvalue * I) y = v by the Thomas algorithm and normalise (repeated for convergence)
+		
+		double *upper = work;
+		double *rhs = work + N;
+		double shift = eigenvalue + 1e-10 * (fabs(eigenvalue) + 1.0);
+		unsigned long i, j;
+		
+		for (i = 0; i < N; i++)
+			vector[i] = 1.0 / sqrt((double) N) * (1.0 + 0.1 * sin((double) i + 1.0));
+		
+		for (j = 0; j < 4; j++)
+		{
+			double pivot = diag[0] - shift;
+			double norm = 0.0;
+			
+			pivot = (pivot == 0.0) ? 1e-300 : pivot;
+			upper[0] = (N > 1) ? off[1] / pivot : 0.0;
+			rhs[0] = vector[0] / pivot;
+			
+			for (i = 1; i < N; i++)
+			{
+				pivot = diag[i] - shift - off[i] * upper[i - 1];
+				pivot = (pivot == 0.0) ? 1e-300 : pivot;
+				upper[i] = (i < N - 1) ? off[i + 1] / pivot : 0.0;
+				rhs[i] = (vector[i] - off[i] * rhs[i - 1]) / pivot;
+			}
+			
+			vector[N - 1] = rhs[N - 1];
+			
+			for (i = N - 1; i > 0; i--)
+				vector[i - 1] = rhs[i - 1] - upper[i - 1] * vector[i];
+			
+			for (i = 0; i < N; i++)
+				norm += vector[i] * vector[i];
+			
+			norm = 1.0 / sqrt(norm);
+			
+			for (i = 0; i < N; i++)
+				vector[i] *= norm;
+		}
+	}
+	
+	
+	static void calculate(double *tapers, unsigned long N, double NW, unsigned long K)
+	{
+		double *diag = new double[N * 5];
+		double *off = diag + N;
+		double *offSq = diag + (N * 2);
+		double *work = diag + (N * 3);
+		double *concentrations = tapers + (N * K);
+		
+		double W = NW / N;
+		double cosTwoPiW = cos(2.0 * M_PI * W);
+		double lo, hi;
+		unsigned long i, k;
+		
+		// Form the tridiagonal matrix (and bound the eigenvalues using the Gershgorin circle theorem)
+		
+		off[0] = offSq[0] = 0.0;
+		
+		for (i = 0; i < N; i++)
+		{
+			double centre = 0.5 * ((double) N - 1.0 - 2.0 * i);
+			
+			diag[i] = centre * centre * cosTwoPiW;
+			
+			if (i)
+			{
+				off[i] = 0.5 * i * (double) (N - i);
+				offSq[i] = off[i] * off[i];
+			}
+		}
+		
+		lo = diag[0] - off[1 % N];
+		hi = diag[0] + off[1 % N];
+		
+		for (i = 0; i < N; i++)
+		{
+			double radius = off[i] + ((i < N - 1) ? off[i + 1] : 0.0);
+			
+			lo = std::min(lo, diag[i] - radius);
+			hi = std::max(hi, diag[i] + radius);
+		}
+		
+		for (k = 0; k < K; k++)
+		{
+			double *taper = tapers + (N * k);
+			double low = lo;
+			double high = hi;
+			double sum = 0.0;
+			
+			// Bisect for the kth largest eigenvalue
+			
+			for (i = 0; i < 200 && (high - low) > 1e-13 * (fabs(low) + fabs(high)); i++)
+			{
+				double mid = 0.5 * (low + high);
+				
+				if (countBelow(diag, offSq, N, mid) > N - 1 - k)
+					high = mid;
+				else
+					low = mid;
+			}
+			
+			inverseIteration(taper, diag, off, work, N, 0.5 * (low + high));
+			
+			// Sign convention - even tapers have a positive sum / odd tapers have a positive first lobe
+			
+			for (i = 0; i < N; i++)
+				sum += (k & 1) ? ((double) N - 1.0 - 2.0 * i) * taper[i] : taper[i];
+			
+			if (sum < 0.0)
+			{
+				for (i = 0; i < N; i++)
+					taper[i] = -taper[i];
+			}
+			
+			// Concentration ratio (from the autocorrelation of the taper)
+			
+			double lambda = 0.0;
+			
+			for (unsigned long d = 0; d < N; d++)
+			{
+				double autocorrelation = 0.0;
+				
+				for (i = 0; i < N - d; i++)
+					autocorrelation += taper[i] * taper[i + d];
+				
+				lambda += d ? 2.0 * autocorrelation * sin(2.0 * M_PI * W * d) / (M_PI * d) : 2.0 * W * autocorrelation;
+			}
+			
+			concentrations[k] = std::max(0.0, std::min(1.0, lambda));
+		}
+		
+		delete[] diag;
+	}
+};
+
+
+#endif
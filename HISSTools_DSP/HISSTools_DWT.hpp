@@ -4,141 +4,102 @@
 #define __HISSTOOLS_DWT__
 
 
+// Wavelets are immutable once constructed and hold their filters inline (up to kMaxTaps), so they may be shared freely and never allocate
+// Filters that are too long leave the wavelet empty (see isValid())
+
 class HISSTools_Wavelet
 {
 	
+	friend class HISSTools_DWT;
+
 public:
 
+	static const unsigned long kMaxTaps = 64;
+
 	// Note that analysis filters should be stored in reverse order, as they are applied through correlation, rather than convolution.....
 	
 	HISSTools_Wavelet()
 	{
-		mForwardLoPass = 0;
-		mForwardHiPass = 0;
-		mInverseLoPass = 0;
-		mInverseHiPass = 0;
-		
 		mForwardLength = 0;
 		mInverseLength = 0;
 		
 		mForwardOffset = 0;
 		mInverseOffset = 0;
-		
-		mInverseIndependent = TRUE;
 	}
 	
 	
 	HISSTools_Wavelet(const double *loPass, unsigned long length, long offset = 0)
 	{
-		HISSTools_Wavelet();
+		// Orthogonal wavelet (the inverse filters are the same as the forward filters)
+		
 		setForwardFilters(loPass, length, offset);
-		setInverseFilters();
+		setInverseFilters(loPass, length, offset);
 	}
 	
 	
-	~HISSTools_Wavelet()
+	HISSTools_Wavelet(const double *forwardLoPass, unsigned long forwardLength, long forwardOffset, const double *inverseLoPass, unsigned long inverseLength, long inverseOffset)
 	{
-		delete[] mForwardLoPass;
-		delete[] mForwardHiPass;
-		
-		if (mInverseIndependent == TRUE)
-		{
-			delete[] mInverseLoPass;
-			delete[] mInverseHiPass;
-		}
+		setForwardFilters(forwardLoPass, forwardLength, forwardOffset);
+		setInverseFilters(inverseLoPass, inverseLength, inverseOffset);
 	}
 	
 	
-	virtual void setForwardFilters(const double *loPass, unsigned long length, long offset = 0)
+	bool isValid() const
+	{
+		return mForwardLength && mInverseLength;
+	}
+
+
+protected:
+
+	static unsigned long setFilters(double *loPass, double *hiPass, const double *filter, unsigned long length)
 	{
 		unsigned long i;
 		double flip;
 		
-		delete[] mForwardLoPass;
-		delete[] mForwardHiPass;
-		
-		mForwardLoPass = new double[length];
-		mForwardHiPass = new double[length];
-		
-		if (!mForwardLoPass || !mForwardHiPass)
-		{
-			delete[] mForwardLoPass;
-			delete[] mForwardHiPass;
-			
-			length = 0;
-			offset = 0;
-		}
+		if (!filter || length > kMaxTaps)
+			return 0;
 		
 		for (i = 0; i < length; i++)
-			mForwardLoPass[i] = loPass[i];
+			loPass[i] = filter[i];
 		
 		for (i = 0, flip = 1; i < length; i++, flip *= -1)
-			mForwardHiPass[i] = mForwardLoPass[length - i - 1] * flip;
+			hiPass[i] = loPass[length - i - 1] * flip;
 				
-		mForwardLength = length;
-		mForwardOffset = offset;
+		return length;
 	}
 	
 	
-	virtual void setInverseFilters(const double *loPass, unsigned long length, long offset = 0)
+	void setForwardFilters(const double *loPass, unsigned long length, long offset = 0)
 	{
-		unsigned long i;
-		double flip;
-		
-		delete[] mInverseLoPass;
-		delete[] mInverseHiPass;
-		
-		mInverseLoPass = new double[length];
-		mInverseHiPass = new double[length];
-		
-		if (!mInverseLoPass || !mInverseHiPass)
-		{
-			delete[] mInverseLoPass;
-			delete[] mInverseHiPass;
-			
-			length = 0;
-			offset = 0;
-		}
-		
-		for (i = 0; i < length; i++)
-			mInverseLoPass[i] = loPass[i];
-		
-		for (i = 0, flip = 1; i < length; i++, flip *= -1)
-			mInverseHiPass[i] = mInverseLoPass[length - i - 1] * flip;
-		
-		mInverseLength = length;
-		mInverseOffset = offset;
-		mInverseIndependent = TRUE;
+		mForwardLength = setFilters(mForwardLoPass, mForwardHiPass, loPass, length);
+		mForwardOffset = mForwardLength ? offset : 0;
 	}
 	
 	
-	virtual void setInverseFilters()
+	void setInverseFilters(const double *loPass, unsigned long length, long offset = 0)
 	{
-		mInverseLength = mForwardLength;
-		mInverseOffset = mForwardOffset;
-		mInverseLoPass = mForwardLoPass;
-		mInverseHiPass = mForwardHiPass;
-		
-		mInverseIndependent = false;
+		mInverseLength = setFilters(mInverseLoPass, mInverseHiPass, loPass, length);
+		mInverseOffset = mInverseLength ? offset : 0;
 	}
 	
 		
+private:
+
 	// FIR Filters
 	
-	double *mForwardLoPass;
-	double *mForwardHiPass;
-	double *mInverseLoPass;
-	double *mInverseHiPass;
+	double mForwardLoPass[kMaxTaps];
+	double mForwardHiPass[kMaxTaps];
+	double mInverseLoPass[kMaxTaps];
+	double mInverseHiPass[kMaxTaps];
 	
 	// Parameters
 	
 	unsigned long mForwardLength;
 	unsigned long mInverseLength;
 	
-	unsigned long mForwardOffset;
-	unsigned long mInverseOffset;
-	
-	bool mInverseIndependent;
+	long mForwardOffset;
+	long mInverseOffset;
 };
 
 
@@ -166,10 +127,10 @@ public:
 	
 private:
 	
-	bool forwardDWT (double *in, double *out, unsigned long length, HISSTools_Wavelet *wavelet)
+	bool forwardDWT (double *in, double *out, unsigned long length, const HISSTools_Wavelet *wavelet)
 	{
-		double *loPass = wavelet->mForwardLoPass;
-		double *hiPass = wavelet->mForwardHiPass;
+		const double *loPass = wavelet->mForwardLoPass;
+		const double *hiPass = wavelet->mForwardHiPass;
 		
 		unsigned long waveletLength = wavelet->mForwardLength;
 		long offset = wavelet->mForwardOffset;
@@ -179,8 +140,8 @@ private:
 		
 		// Sanity Check
 		
-		if (waveletLength > length)
-			FALSE;
+		if (!waveletLength || waveletLength > length)
+			return FALSE;
 				
 		// Loop by output sample
 		
@@ -221,10 +182,10 @@ private:
 	}
 	
 	
-	bool inverseDWT (double *in, double *out, unsigned long length, HISSTools_Wavelet *wavelet)
+	bool inverseDWT (double *in, double *out, unsigned long length, const HISSTools_Wavelet *wavelet)
 	{
-		double *loPass = wavelet->mInverseLoPass;
-		double *hiPass = wavelet->mInverseHiPass;
+		const double *loPass = wavelet->mInverseLoPass;
+		const double *hiPass = wavelet->mInverseHiPass;
 		
 		unsigned long waveletLength = wavelet->mInverseLength;
 		long offset = wavelet->mInverseOffset;
@@ -232,7 +193,7 @@ private:
 			
 		// Sanity Check
 		
-		if (waveletLength > length)
+		if (!waveletLength || waveletLength > length)
 			return FALSE;
 		
 		// Zero output
@@ -268,7 +229,7 @@ private:
 	
 public:
 	
-	bool forwardDWT (double *in, double *out, unsigned long length, unsigned long levels, HISSTools_Wavelet *wavelet)
+	bool forwardDWT (double *in, double *out, unsigned long length, unsigned long levels, const HISSTools_Wavelet *wavelet)
 	{
 		bool success = TRUE;
 		double *temp = mTemp;
@@ -293,7 +254,7 @@ public:
 	}
 	
 	
-	bool inverseDWT (double *in, double *out, unsigned long length, unsigned long levels, HISSTools_Wavelet *wavelet)
+	bool inverseDWT (double *in, double *out, unsigned long length, unsigned long levels, const HISSTools_Wavelet *wavelet)
 	{
 		bool success = TRUE;
 		double *temp = mTemp;
@@ -319,13 +280,13 @@ public:
 	}
 	
 	
-	bool forwardDWT (double *io, unsigned long length, unsigned long levels, HISSTools_Wavelet *wavelet)
+	bool forwardDWT (double *io, unsigned long length, unsigned long levels, const HISSTools_Wavelet *wavelet)
 	{
 		return forwardDWT (io, io, length, levels, wavelet);
 	}
 	
 	
-	bool inverseDWT (double *io, unsigned long length, unsigned long levels, HISSTools_Wavelet *wavelet)
+	bool inverseDWT (double *io, unsigned long length, unsigned long levels, const HISSTools_Wavelet *wavelet)
 	{
 		return inverseDWT (io, io, length, levels, wavelet);
 	}	
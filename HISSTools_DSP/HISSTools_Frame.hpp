@@ -5,16 +5,26 @@
 
 #include <cmath>
 #include "HISSTools_IOStream.hpp"
+#include "HISSTools_Resampler.hpp"
 
-class HISSTools_Frame {
+
+// Statically dispatched engine (CRTP)
+//
+// Derive as class MyFrame : public HISSTools_Frame_Base <MyFrame> so that process() is resolved (and can be inlined) at compile time
+// Declare the process() overloads you need with the same signatures as below (non-virtual) and make them accessible to the base
+// If only some overloads are declared add using HISSTools_Frame_Base <MyFrame>::process; so that the defaults remain visible
+
+template <class Derived>
+class HISSTools_Frame_Base {
 	
 public:
 	
-	HISSTools_Frame(unsigned long maxFrameSize, unsigned long maxChans)
+	HISSTools_Frame_Base(unsigned long maxFrameSize, unsigned long maxChans)
 	{
-        mInputStream = new HISSTools_IOStream(HISSTools_IOStream::kInput, maxFrameSize, maxChans);
+        // The stream has room for the extra samples needed by fractional frames
         
-        mMaxFrameSize = mInputStream->getBufferSize();
+        mMaxFrameSize = std::max(1UL, maxFrameSize);
+        mInputStream = new HISSTools_IOStream(HISSTools_IOStream::kInput, mMaxFrameSize + kMaxFractionalTaps, maxChans);
         mNChans = mInputStream->getNChans();
         
 		// Allocate individual channel pointers
@@ -24,13 +34,43 @@ public:
 	
         mBlockHopCounter = 0;
         mHopShift = 0;
+        mStreamCount = 0;
+        mHostCount = 0;
+        mFrameEnd = 0;
+        
+        // No resampling by default
+        
+        mResampler = NULL;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            mResampled[i] = NULL;
+        
+        // Integer aligned frames by default
+        
+        mFractionalTaps = 0;
+        mFrameDelay = 0.0;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            mFractionalBuffers[i] = NULL;
+        
+        // No tempo sync by default
+        
+        mSamplesPerBeat = 0.0;
+        mTimelinePosition = 0.0;
+        mTimelineTime = 0.0;
+        mTimelineHostTime = 0.0;
+        mSamplingRate = 0.0;
+        mNTempoChanges = 0;
+        mTempoChangeRead = 0;
+        
+        setTempoSync(0, 1);
         
         reset();
 		setParams(maxFrameSize, maxFrameSize, TRUE);
 	}
 		
 	
-	~HISSTools_Frame()
+	~HISSTools_Frame_Base()
 	{
         // Delete Stream
         
@@ -40,10 +80,20 @@ public:
 
 		for (unsigned long i = 0; i < mNChans; i++) 
             delete[] mFrameBuffers[i];
+        
+        // Delete resampler and fractional buffers
+        
+        setInternalRate(1.0, 1.0);
+        setFractionalFrames(0);
 	}
 	
 	
 private:
+
+    Derived *derived()
+    {
+        return static_cast<Derived *>(this);
+    }
     
     double getHopCounter()
     {
@@ -67,6 +117,48 @@ private:
     }
     
     bool streamToFrame(double **ins, unsigned long nChans, unsigned long nSamps, bool SingleChannel)
+	{
+        double *chunkIns[256];
+        
+        bool processedFrames = FALSE;
+        
+        // Sanity Check
+        
+        if (nChans > mNChans)
+            return FALSE;
+        
+        if (mResetStrean == TRUE)
+        {
+            mHostCount = 0;
+            
+            if (mResampler)
+                mResampler->reset();
+        }
+        
+        mHostCount += nSamps;
+        
+        if (!mResampler)
+            return streamFrames(ins, nChans, nSamps, SingleChannel);
+        
+        // Resample in chunks and frame at the internal rate
+        
+        for (unsigned long i = 0; i < nSamps; i += kResampleChunk)
+        {
+            unsigned long chunkSize = (nSamps - i) < kResampleChunk ? (nSamps - i) : kResampleChunk;
+            
+            for (unsigned long j = 0; j < nChans; j++)
+                chunkIns[j] = ins[j] + i;
+            
+            unsigned long nResampled = mResampler->process(chunkIns, mResampled, nChans, chunkSize);
+            
+            if (streamFrames(mResampled, nChans, nResampled, SingleChannel) == TRUE)
+                processedFrames = TRUE;
+        }
+        
+        return processedFrames;
+    }
+    
+    bool streamFrames(double **ins, unsigned long nChans, unsigned long nSamps, bool SingleChannel)
 	{
         bool processedFrames = FALSE;
         
@@ -86,6 +178,7 @@ private:
         if (mResetStrean == TRUE)
         {
             mInputStream->reset();
+            mStreamCount = 0;
             mResetStrean = FALSE;
         }
         
@@ -95,6 +188,9 @@ private:
             mResetHopCount = FALSE;
         }
         
+        if (mBeatsNumerator)
+            return streamTempoFrames(ins, nChans, nSamps, SingleChannel);
+		
 		// Get parameters
 		
 		frameSize = mFrameSize;
@@ -115,12 +211,13 @@ private:
                 hopCounter = hopCounter <= 0.0 ? 0.0: hopCounter;
                 hopCounter = hopCounter >= 1.0 ? 0.0: hopCounter;
                 
-                mInputStream->read(mFrameBuffers, nChans, frameSize, 0);
+                double fractionalOffset = readFrame(nChans, frameSize, hopCounter ? 1.0 - hopCounter : 0.0);
+                mFrameEnd = mStreamCount + i;
 				
                 if (SingleChannel == TRUE)
-                    process(mFrameBuffers[0], frameSize, hopCounter ? 1.0 - hopCounter : 0.0);
+                    derived()->process(mFrameBuffers[0], frameSize, fractionalOffset);
                 else
-                    process(mFrameBuffers, frameSize, nChans, hopCounter ? 1.0 - hopCounter : 0.0);
+                    derived()->process(mFrameBuffers, frameSize, nChans, fractionalOffset);
 			}
 			
 			// Check loop size
@@ -134,35 +231,196 @@ private:
 		}
 		
 		mBlockHopCounter = hopCounter;
+        mStreamCount += nSamps;
 		
 		return processedFrames;
 	}
+	
+    bool streamTempoFrames(double **ins, unsigned long nChans, unsigned long nSamps, bool SingleChannel)
+    {
+        bool processedFrames = FALSE;
+        
+        unsigned long frameSize = mFrameSize;
+        unsigned long i = 0;
+        
+        double blockEnd = (double) (mStreamCount + nSamps);
+        
+        // Grab a frame for each beat hop that ends within this vector (nothing is taken until a timeline is set)
+        
+        while (mSamplesPerBeat)
+        {
+            double frameTime = getBeatFrameTime();
+            double frameEnd = ceil(frameTime);
+            
+            if (frameTime > blockEnd)
+                break;
+            
+            // Write up to the end of the frame (frames that are already due are taken immediately)
+            
+            if (frameEnd > (double) (mStreamCount + i))
+            {
+                unsigned long loopSize = (unsigned long) (frameEnd - (double) mStreamCount) - i;
+                mInputStream->write(ins, nChans, loopSize, i);
+                i += loopSize;
+            }
+            
+            double overshoot = (double) (mStreamCount + i) - frameTime;
+            double fractionalOffset = (overshoot > 0.0 && overshoot < 1.0) ? 1.0 - overshoot : 0.0;
+            
+            processedFrames = TRUE;
+            
+            fractionalOffset = readFrame(nChans, frameSize, fractionalOffset);
+            mFrameEnd = mStreamCount + i;
+            
+            if (SingleChannel == TRUE)
+                derived()->process(mFrameBuffers[0], frameSize, fractionalOffset);
+            else
+                derived()->process(mFrameBuffers, frameSize, nChans, fractionalOffset);
+            
+            mLastBeatHop = mNextBeatHop++;
+            mBeatHopValid = TRUE;
+        }
+        
+        // Write the remainder
+        
+        if (i < nSamps)
+            mInputStream->write(ins, nChans, nSamps - i, i);
+        
+        mStreamCount += nSamps;
+        
+        return processedFrames;
+    }
+    
+    double getBeatPosition(long long hop)
+    {
+        // Calculated from the integer hop index so that no rounding error accumulates from hop to hop
+        
+        return (double) (hop * mBeatsNumerator) / (double) mBeatsDenominator + mBeatPhase;
+    }
+    
+    double getBeatFrameTime()
+    {
+        // Internal sample time of the next beat hop (applying any tempo changes that occur before it)
+        
+        double frameTime = mTimelineTime + (getBeatPosition(mNextBeatHop) - mTimelinePosition) * mSamplesPerBeat;
+        
+        while (mTempoChangeRead < mNTempoChanges && mTempoChanges[mTempoChangeRead].mTime <= frameTime)
+        {
+            TempoChange &change = mTempoChanges[mTempoChangeRead++];
+            
+            mTimelinePosition += (change.mTime - mTimelineTime) / mSamplesPerBeat;
+            mTimelineTime = change.mTime;
+            mSamplesPerBeat = change.mSamplesPerBeat;
+            
+            frameTime = mTimelineTime + (getBeatPosition(mNextBeatHop) - mTimelinePosition) * mSamplesPerBeat;
+        }
+        
+        return frameTime;
+    }
+    
+    double readFrame(unsigned long nChans, unsigned long frameSize, double fractionalOffset)
+    {
+        // Read the most recent frame from the stream and return the fractional offset to pass to process()
+        
+        if (!mFractionalTaps)
+        {
+            mInputStream->read(mFrameBuffers, nChans, frameSize, 0);
+            mFrameDelay = 0.0;
+            
+            return fractionalOffset;
+        }
+        
+        // Fractional frames are interpolated to the exact position of the frame (delayed by half the kernel)
+        
+        unsigned long nTaps = mFractionalTaps;
+        unsigned long half = nTaps >> 1;
+        
+        mInputStream->read(mFractionalBuffers, nChans, frameSize + nTaps, 0);
+        mFrameDelay = half + (fractionalOffset ? 1.0 - fractionalOffset : 0.0);
+        
+        if (!fractionalOffset)
+        {
+            for (unsigned long i = 0; i < nChans; i++)
+                for (unsigned long j = 0; j < frameSize; j++)
+                    mFrameBuffers[i][j] = mFractionalBuffers[i][half + j];
+            
+            return 0.0;
+        }
+        
+        // Blackman windowed sinc kernel (normalised for unity gain at DC)
+        
+        double kernelSum = 0.0;
+        
+        for (unsigned long i = 0; i < nTaps; i++)
+        {
+            double x = fractionalOffset + (double) half - 1.0 - (double) i;
+            double window = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2.0 * M_PI * x / half);
+            
+            mFractionalKernel[i] = window * sin(M_PI * x) / (M_PI * x);
+            kernelSum += mFractionalKernel[i];
+        }
+        
+        for (unsigned long i = 0; i < nTaps; i++)
+            mFractionalKernel[i] /= kernelSum;
+        
+        // Filter (looping over taps outside so that the inner loop runs contiguously over the frame)
+        
+        for (unsigned long i = 0; i < nChans; i++)
+        {
+            double *frame = mFrameBuffers[i];
+            
+            for (unsigned long j = 0; j < frameSize; j++)
+                frame[j] = 0.0;
+            
+            for (unsigned long j = 0; j < nTaps; j++)
+            {
+                const double *input = mFractionalBuffers[i] + j;
+                double coefficient = mFractionalKernel[j];
+                
+                for (unsigned long k = 0; k < frameSize; k++)
+                    frame[k] += coefficient * input[k];
+            }
+        }
+        
+        return 0.0;
+    }
+    
+    double getInternalTime(double hostTime)
+    {
+        // Internal sample time at which the input at a given host time appears (compensated for resampler latency)
+        
+        return mResampler ? (hostTime + mResampler->getLatency()) / mResampler->getStep() : hostTime;
+    }
+    
+    double getSamplesPerBeat(double tempo, double samplingRate)
+    {
+        if (tempo <= 0.0 || samplingRate <= 0.0)
+            return 0.0;
+        
+        return (60.0 * samplingRate / tempo) / (mResampler ? mResampler->getStep() : 1.0);
+    }
 
 	
 protected:
 	
-	void virtual process(double *iFrame, unsigned long frameSize)
+	// Default processing (hidden by the derived class declarations - calls are dispatched to the derived class)
+	
+	void process(double *iFrame, unsigned long frameSize)
 	{
-		// This function should be overridden for single channel operation (where you wish to ignore fractional offsets).
 	}
 	
-	void virtual process(double **iFrames, unsigned long frameSize, unsigned long nChans)
+	void process(double **iFrames, unsigned long frameSize, unsigned long nChans)
 	{
-		// This function should be overridden for multichannel operation (where you wish to ignore fractional offsets).
 	}
 	
-    void virtual process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+    void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
 	{
-		// This function should be overridden for single channel operation (where you wish to receive fractional offsets)
-        
-        process(iFrame, frameSize);
+        derived()->process(iFrame, frameSize);
 	}
 	
-	void virtual process(double **iFrames, unsigned long frameSize, unsigned long nChans, double fractionalOffset)
+	void process(double **iFrames, unsigned long frameSize, unsigned long nChans, double fractionalOffset)
 	{
-		// This function should be overridden for multichannel operation where you wish to receive fractional offsets).
-        
-        process(iFrames, frameSize, nChans);
+        derived()->process(iFrames, frameSize, nChans);
 	}
 	
 public:
@@ -205,7 +463,256 @@ public:
         mResetStrean = TRUE;
         mResetHopCount = TRUE;
 	}
+    
+    bool setInternalRate(double hostRate, double internalRate)
+    {
+        // Frames are taken at the internal rate (resampling is removed if the internal rate is not lower than the host rate)
+        // N.B. this allocates memory and is not threadsafe
+        
+        delete mResampler;
+        mResampler = NULL;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+        {
+            delete[] mResampled[i];
+            mResampled[i] = NULL;
+        }
+        
+        reset();
+        
+        if (hostRate <= 0.0 || internalRate <= 0.0 || internalRate >= hostRate)
+            return internalRate == hostRate;
+        
+        mResampler = new HISSTools_Resampler(mNChans);
+        mResampler->setRates(hostRate, internalRate);
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            mResampled[i] = new double[mResampler->getMaxOutput(kResampleChunk)];
+        
+        return TRUE;
+    }
+    
+    double getHostOffset(double fractionalOffset)
+    {
+        // Convert a fractional offset (in internal samples) to host samples
+        
+        return mResampler ? fractionalOffset * mResampler->getStep() : fractionalOffset;
+    }
+    
+    double getFrameHostTime()
+    {
+        // Host sample time (since the last reset) of the last sample of the most recent frame (compensated for resampler latency)
+        // For fractional frames this is the exact (interpolated) position of the last sample
+        
+        double lastSample = (double) mFrameEnd - 1.0 - mFrameDelay;
+        
+        return mResampler ? lastSample * mResampler->getStep() - mResampler->getLatency() : lastSample;
+    }
+    
+    void setFractionalFrames(unsigned long nTaps)
+    {
+        // Frames are interpolated to their exact (fractional) position with a windowed sinc of nTaps (even, up to 64 - zero for off)
+        // Interpolated frames lag by a fixed nTaps / 2 samples (included in getFrameHostTime()) and process() receives a zero offset
+        // N.B. this allocates memory and is not threadsafe
+        
+        nTaps = nTaps ? (nTaps + 1) & ~1UL : 0;
+        nTaps = nTaps > kMaxFractionalTaps ? kMaxFractionalTaps : nTaps;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+        {
+            delete[] mFractionalBuffers[i];
+            mFractionalBuffers[i] = nTaps ? new double[mMaxFrameSize + kMaxFractionalTaps] : NULL;
+        }
+        
+        mFractionalTaps = nTaps;
+    }
 	
+    void setTempoSync(unsigned long beatsNumerator, unsigned long beatsDenominator, double beatPhase = 0.0)
+    {
+        // Frames are taken every beatsNumerator / beatsDenominator beats (offset by beatPhase) in place of the hop size
+        // Tempo sync is switched off with a numerator (or denominator) of zero
+        
+        bool sync = beatsNumerator && beatsDenominator;
+        
+        mBeatsNumerator = sync ? beatsNumerator : 0;
+        mBeatsDenominator = sync ? beatsDenominator : 1;
+        mBeatPhase = beatPhase;
+        mNextBeatHop = 0;
+        mLastBeatHop = 0;
+        mBeatHopValid = FALSE;
+    }
+    
+    void setTimeline(double ppqPosition, double tempo, double samplingRate)
+    {
+        // Call before streaming each vector with the host position (in beats) and tempo (in bpm) at the start of the vector
+        // The sampling rate is the host rate (resampling is accounted for) - any tempo changes from the last vector are discarded
+        
+        double beatsPerHop = (double) mBeatsNumerator / (double) mBeatsDenominator;
+        
+        mTimelineHostTime = mResetStrean == TRUE ? 0.0 : (double) mHostCount;
+        mTimelineTime = getInternalTime(mTimelineHostTime);
+        mTimelinePosition = ppqPosition;
+        mSamplesPerBeat = getSamplesPerBeat(tempo, samplingRate);
+        mSamplingRate = samplingRate;
+        mNTempoChanges = 0;
+        mTempoChangeRead = 0;
+        
+        if (!mBeatsNumerator)
+            return;
+        
+        // Find the first hop at or after the position of the internal stream (which lags the host by any resampler latency)
+        // Hops already taken are not repeated unless the timeline jumps back
+        
+        double streamTime = mResetStrean == TRUE ? 0.0 : (double) mStreamCount;
+        double streamPosition = mSamplesPerBeat ? ppqPosition + (streamTime - mTimelineTime) / mSamplesPerBeat : ppqPosition;
+        
+        long long nextHop = (long long) ceil((streamPosition - mBeatPhase) / beatsPerHop - 1e-9);
+        
+        if (mBeatHopValid == TRUE && nextHop <= mLastBeatHop && streamPosition > getBeatPosition(mLastBeatHop) - beatsPerHop)
+            nextHop = mLastBeatHop + 1;
+        
+        mNextBeatHop = nextHop;
+    }
+    
+    bool addTempoChange(unsigned long offset, double tempo)
+    {
+        // Apply a tempo change at a sample offset (in host samples) from the start of the current vector
+        // Changes must be added in order after calling setTimeline()
+        
+        double time = getInternalTime(mTimelineHostTime + offset);
+        
+        if (!mSamplesPerBeat || mNTempoChanges >= kMaxTempoChanges || tempo <= 0.0)
+            return FALSE;
+        
+        if (mNTempoChanges && time < mTempoChanges[mNTempoChanges - 1].mTime)
+            return FALSE;
+        
+        mTempoChanges[mNTempoChanges].mTime = time;
+        mTempoChanges[mNTempoChanges].mSamplesPerBeat = getSamplesPerBeat(tempo, mSamplingRate);
+        mNTempoChanges++;
+        
+        return TRUE;
+    }
+
+    // State
+    
+    unsigned long getStateSize()
+    {
+        HISSTools_StateWriter writer;
+        writeState(writer);
+        return writer.getPosition();
+    }
+    
+    bool saveState(void *data, unsigned long size)
+    {
+        HISSTools_StateWriter writer(data, size);
+        writeState(writer);
+        return writer.isValid();
+    }
+    
+    bool restoreState(const void *data, unsigned long size)
+    {
+        HISSTools_StateReader reader(data, size);
+        return readState(reader);
+    }
+    
+    void writeState(HISSTools_StateWriter& writer)
+    {
+        // The stream and resampler are stored within the frame state
+        
+        unsigned long position = writer.beginState(kStateTagFrame, kStateVersion);
+        bool resampled = mResampler != NULL;
+        
+        writer.write(mMaxFrameSize);
+        writer.write(mNChans);
+        writer.write(mFractionalTaps);
+        writer.write(resampled);
+        
+        if (mResampler)
+            mResampler->writeState(writer);
+        
+        mInputStream->writeState(writer);
+        
+        writer.write(mFrameDelay);
+        writer.write(mStreamCount);
+        writer.write(mHostCount);
+        writer.write(mFrameEnd);
+        
+        writer.write(mTempoChanges, kMaxTempoChanges);
+        writer.write(mNTempoChanges);
+        writer.write(mTempoChangeRead);
+        writer.write(mBeatsNumerator);
+        writer.write(mBeatsDenominator);
+        writer.write(mNextBeatHop);
+        writer.write(mLastBeatHop);
+        writer.write(mBeatHopValid);
+        writer.write(mBeatPhase);
+        writer.write(mTimelinePosition);
+        writer.write(mTimelineTime);
+        writer.write(mTimelineHostTime);
+        writer.write(mSamplesPerBeat);
+        writer.write(mSamplingRate);
+        
+        writer.write(mBlockHopCounter);
+        writer.write(mHopSize);
+        writer.write(mHopShift);
+        writer.write(mFrameSize);
+        writer.write(mResetStrean);
+        writer.write(mResetHopCount);
+        
+        writer.endState(position);
+    }
+    
+    bool readState(HISSTools_StateReader& reader)
+    {
+        // The maximums, fractional frames and internal rate must match (set them before restoring - nothing is restored otherwise)
+        
+        if (reader.beginState(kStateTagFrame, kStateVersion, getStateSize()) == FALSE)
+            return FALSE;
+        if (reader.check(mMaxFrameSize) == FALSE || reader.check(mNChans) == FALSE || reader.check(mFractionalTaps) == FALSE || reader.check(mResampler != NULL) == FALSE)
+            return FALSE;
+        
+        // The size of the state is fixed by the checks above, so only the resampler rates (or corrupt stream counters) can fail from here
+        
+        if (mResampler && mResampler->readState(reader) == FALSE)
+            return FALSE;
+        if (mInputStream->readState(reader) == FALSE)
+            return FALSE;
+        
+        reader.read(mFrameDelay);
+        reader.read(mStreamCount);
+        reader.read(mHostCount);
+        reader.read(mFrameEnd);
+        
+        reader.read(mTempoChanges, kMaxTempoChanges);
+        reader.read(mNTempoChanges);
+        reader.read(mTempoChangeRead);
+        reader.read(mBeatsNumerator);
+        reader.read(mBeatsDenominator);
+        reader.read(mNextBeatHop);
+        reader.read(mLastBeatHop);
+        reader.read(mBeatHopValid);
+        reader.read(mBeatPhase);
+        reader.read(mTimelinePosition);
+        reader.read(mTimelineTime);
+        reader.read(mTimelineHostTime);
+        reader.read(mSamplesPerBeat);
+        reader.read(mSamplingRate);
+        
+        reader.read(mBlockHopCounter);
+        reader.read(mHopSize);
+        reader.read(mHopShift);
+        reader.read(mFrameSize);
+        reader.read(mResetStrean);
+        reader.read(mResetHopCount);
+        
+        mNTempoChanges = mNTempoChanges < kMaxTempoChanges ? mNTempoChanges : kMaxTempoChanges;
+        mTempoChangeRead = std::min(mTempoChangeRead, mNTempoChanges);
+        mFrameSize = std::max(1UL, std::min(mMaxFrameSize, mFrameSize));
+        
+        return reader.isValid();
+    }
+
 // FIX - look at what is private here....
 // FIX - add last frame facility
     
@@ -219,6 +726,59 @@ protected:
 
 private:
 
+    // Resampling
+    
+    static const unsigned long kResampleChunk = 256;
+    
+    HISSTools_Resampler *mResampler;
+    double *mResampled[256];
+    
+    // Fractional Frames
+    
+    static const unsigned long kMaxFractionalTaps = 64;
+    
+    unsigned long mFractionalTaps;
+    double *mFractionalBuffers[256];
+    double mFractionalKernel[kMaxFractionalTaps];
+    double mFrameDelay;
+    
+    // State Version
+    
+    static const uint32_t kStateVersion = 1;
+    
+    // Stream Position
+    
+    unsigned long long mStreamCount;
+    unsigned long long mHostCount;
+    unsigned long long mFrameEnd;
+    
+    // Tempo Sync
+    
+    static const unsigned long kMaxTempoChanges = 64;
+    
+    struct TempoChange
+    {
+        double mTime;
+        double mSamplesPerBeat;
+    };
+    
+    TempoChange mTempoChanges[kMaxTempoChanges];
+    unsigned long mNTempoChanges;
+    unsigned long mTempoChangeRead;
+    
+    long long mBeatsNumerator;
+    long long mBeatsDenominator;
+    long long mNextBeatHop;
+    long long mLastBeatHop;
+    bool mBeatHopValid;
+    
+    double mBeatPhase;
+    double mTimelinePosition;
+    double mTimelineTime;
+    double mTimelineHostTime;
+    double mSamplesPerBeat;
+    double mSamplingRate;
+
 	// Hop Parameters
 	
 	double mBlockHopCounter;
@@ -241,4 +801,46 @@ private:
 };
 
 
+// Virtual processing interface
+//
+// Derive from this class and override the process() overloads (as before) - each frame costs a virtual call
+
+class HISSTools_Frame : public HISSTools_Frame_Base <HISSTools_Frame>
+{
+    friend class HISSTools_Frame_Base <HISSTools_Frame>;
+
+public:
+
+    HISSTools_Frame(unsigned long maxFrameSize, unsigned long maxChans) : HISSTools_Frame_Base <HISSTools_Frame> (maxFrameSize, maxChans)
+    {
+    }
+
+protected:
+
+	void virtual process(double *iFrame, unsigned long frameSize)
+	{
+		// This function should be overridden for single channel operation (where you wish to ignore fractional offsets).
+	}
+	
+	void virtual process(double **iFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		// This function should be overridden for multichannel operation (where you wish to ignore fractional offsets).
+	}
+	
+    void virtual process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		// This function should be overridden for single channel operation (where you wish to receive fractional offsets)
+		
+        process(iFrame, frameSize);
+	}
+	
+	void virtual process(double **iFrames, unsigned long frameSize, unsigned long nChans, double fractionalOffset)
+	{
+		// This function should be overridden for multichannel operation where you wish to receive fractional offsets).
+		
+        process(iFrames, frameSize, nChans);
+	}
+};
+
+
 #endif
\ No newline at end of file
@@ -3,13 +3,35 @@
 #ifndef __HISSTOOLS_FRAME_DELAY__
 #define __HISSTOOLS_FRAME_DELAY__
 
+#include <stdint.h>
+
+#include "../HISSTools_Utility/HISSTools_State.hpp"
+
+
+// Storage formats for frame history (selected at construction)
+//
+// kFrameStoreDouble		- 8 bytes per value - lossless
+// kFrameStoreFloat			- 4 bytes per value - relative error < 6e-8 (range +/- 3.4e38)
+// kFrameStoreHalf			- 2 bytes per value - relative error < 4.9e-4 (range +/- 65504 - larger values saturate to inf)
+// kFrameStoreLogMagnitude	- 2 bytes per value - sign plus 15 bit log2 magnitude over 2^-64 to 2^64 (relative error < 0.14%, values below 2^-64 read as zero)
+//
+// The log magnitude format suits power / amplitude frames with a wide dynamic range that would saturate or flush in half precision
+
+enum FrameDelayStorage {
+
+	kFrameStoreDouble = 0,
+	kFrameStoreFloat = 1,
+	kFrameStoreHalf = 2,
+	kFrameStoreLogMagnitude = 3,
+};
+
 
 class HISSTools_Frame_Delay
 {
 	
 public:
 	
-	HISSTools_Frame_Delay(unsigned long maxFrameSize, unsigned long maxNumFrames, unsigned long maxChans = 1) 
+	HISSTools_Frame_Delay(unsigned long maxFrameSize, unsigned long maxNumFrames, unsigned long maxChans = 1, FrameDelayStorage storage = kFrameStoreDouble) : mStorage(storage)
 	{
 		bool success;
 		unsigned long i;
@@ -30,11 +52,15 @@ public:
 
 		mMaxFrameSize = 0;
 		mMaxNumFrames = 0;
+		mMaxChans = 0;
 		mFrameData = 0;
+		mFrameSize = 0;
+		
+		mBytesPerValue = bytesPerValue(storage);
 		
 		// Allocate channel array
 		
-		mFrameData = new double *[maxChans];
+		mFrameData = new unsigned char *[maxChans];
 
 		if (mFrameData)
 			mMaxChans = maxChans;
@@ -42,7 +68,7 @@ public:
 		// Allocate individual channel pointers
 		
 		for (i = 0; i < mMaxChans; i++)
-			mFrameData[i] = new double[maxFrameSize * maxNumFrames];
+			mFrameData[i] = new unsigned char[maxFrameSize * maxNumFrames * mBytesPerValue];
 		
 		for (i = 0, success = TRUE; i < mMaxChans; i++)
 			if (!mFrameData[i])
@@ -71,6 +97,18 @@ public:
 	
 private:
 	
+	static unsigned long bytesPerValue(FrameDelayStorage storage)
+	{
+		switch (storage)
+		{
+			case kFrameStoreFloat:			return sizeof(float);
+			case kFrameStoreHalf:			return sizeof(uint16_t);
+			case kFrameStoreLogMagnitude:	return sizeof(uint16_t);
+			default:						return sizeof(double);
+		}
+	}
+	
+	
 	void reset(unsigned long frameSize)
 	{
 		mFrameSize = frameSize;
@@ -80,26 +118,196 @@ private:
 	}
 
 	
-	void SingleChannelIO(double *in, double *out, double *chanFrameData, unsigned long frameSize, unsigned long readPointer, unsigned long writePointer)
+	// Half precision conversion (round to nearest even, saturating to inf and flushing below the smallest denormal)
+	
+	static uint16_t encodeHalf(double in)
+	{
+		float value = (float) in;
+		uint32_t bits;
+		
+		memcpy(&bits, &value, sizeof(uint32_t));
+		
+		uint32_t sign = (bits >> 16) & 0x8000U;
+		uint32_t absBits = bits & 0x7FFFFFFFU;
+		
+		// NaN / Overflow / Denormals and underflow / Normal range
+		
+		if (absBits > 0x7F800000U)
+			return (uint16_t) (sign | 0x7E00U);
+		if (absBits >= 0x477FF000U)
+			return (uint16_t) (sign | 0x7C00U);
+		if (absBits < 0x38800000U)
+		{
+			if (absBits < 0x33000000U)
+				return (uint16_t) sign;
+			
+			uint32_t shift = 126U - (absBits >> 23);
+			uint32_t mantissa = (absBits & 0x007FFFFFU) | 0x00800000U;
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1U << shift) - 1U);
+			uint32_t halfway = 1U << (shift - 1U);
+			
+			half += (remainder > halfway || (remainder == halfway && (half & 1U))) ? 1U : 0U;
+			
+			return (uint16_t) (sign | half);
+		}
+		
+		absBits += 0xC8000FFFU + ((absBits >> 13) & 1U);
+		
+		return (uint16_t) (sign | (absBits >> 13));
+	}
+	
+	
+	static double decodeHalf(uint16_t in)
+	{
+		uint32_t sign = ((uint32_t) in & 0x8000U) << 16;
+		uint32_t exponent = (in >> 10) & 0x1FU;
+		uint32_t mantissa = in & 0x03FFU;
+		uint32_t bits;
+		float value;
+		
+		if (exponent == 0x1FU)
+			bits = sign | 0x7F800000U | (mantissa << 13);
+		else if (exponent)
+			bits = sign | ((exponent + 112U) << 23) | (mantissa << 13);
+		else
+		{
+			value = (float) mantissa * (1.f / 16777216.f);
+			return sign ? -value : value;
+		}
+		
+		memcpy(&value, &bits, sizeof(float));
+		
+		return value;
+	}
+	
+	
+	// Log magnitude conversion (bit 15 is the sign - code zero is reserved for values below the range)
+	
+	static uint16_t encodeLogMagnitude(double in)
+	{
+		double magnitude = fabs(in);
+		uint16_t sign = in < 0.0 ? 0x8000U : 0U;
+		
+		if (!(magnitude >= kLogMagnitudeMin))
+			return 0U;
+		
+		double code = (log2(magnitude) + kLogMagnitudeRange) * kLogMagnitudeScale + 1.0;
+		
+		code = code < 32767.0 ? code : 32767.0;
+		
+		return (uint16_t) (sign | (uint16_t) (code + 0.5));
+	}
+	
+	
+	static double decodeLogMagnitude(uint16_t in)
+	{
+		uint16_t code = in & 0x7FFFU;
+		
+		if (!code)
+			return 0.0;
+		
+		double magnitude = exp2((code - 1.0) * (1.0 / kLogMagnitudeScale) - kLogMagnitudeRange);
+		
+		return (in & 0x8000U) ? -magnitude : magnitude;
+	}
+	
+	
+	void encodeFrame(unsigned char *frameData, double *in, unsigned long frameSize)
 	{
-		double *frameData;
 		unsigned long i;
 		
+		switch (mStorage)
+		{
+			case kFrameStoreDouble:
+				memcpy(frameData, in, frameSize * sizeof(double));
+				break;
+			
+			case kFrameStoreFloat:
+			{
+				float *out = (float *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = (float) in[i];
+				break;
+			}
+			
+			case kFrameStoreHalf:
+			{
+				uint16_t *out = (uint16_t *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = encodeHalf(in[i]);
+				break;
+			}
+			
+			case kFrameStoreLogMagnitude:
+			{
+				uint16_t *out = (uint16_t *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = encodeLogMagnitude(in[i]);
+				break;
+			}
+		}
+	}
+	
+	
+	void decodeFrame(double *out, unsigned char *frameData, unsigned long frameSize)
+	{
+		unsigned long i;
+		
+		switch (mStorage)
+		{
+			case kFrameStoreDouble:
+				memcpy(out, frameData, frameSize * sizeof(double));
+				break;
+			
+			case kFrameStoreFloat:
+			{
+				float *in = (float *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = in[i];
+				break;
+			}
+			
+			case kFrameStoreHalf:
+			{
+				uint16_t *in = (uint16_t *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = decodeHalf(in[i]);
+				break;
+			}
+			
+			case kFrameStoreLogMagnitude:
+			{
+				uint16_t *in = (uint16_t *) frameData;
+				
+				for (i = 0; i < frameSize; i++)
+					out[i] = decodeLogMagnitude(in[i]);
+				break;
+			}
+		}
+	}
+	
+	
+	void SingleChannelIO(double *in, double *out, unsigned char *chanFrameData, unsigned long frameSize, long readPointer, unsigned long writePointer)
+	{
+		unsigned long frameBytes = mMaxFrameSize * mBytesPerValue;
+		
 		// Copy in current frame
 		
-		for (i = 0, frameData = chanFrameData + (writePointer * mMaxFrameSize); i < frameSize; i++)
-			frameData[i] = in[i];
+		encodeFrame(chanFrameData + (writePointer * frameBytes), in, frameSize);
 		
 		// Get output frame
 		
 		if (readPointer >= 0)
-		{
-			for (i = 0, frameData = chanFrameData + (readPointer * mMaxFrameSize); i < frameSize; i++)
-				out[i] = frameData[i];
-		}
+			decodeFrame(out, chanFrameData + (readPointer * frameBytes), frameSize);
 		else 
 		{
-			for (i = 0; i < frameSize; i++)
+			for (unsigned long i = 0; i < frameSize; i++)
 				out[i] = 0.;
 		}
 	}
@@ -111,7 +319,7 @@ public:
 	bool delayIO(double **in, double **out, unsigned long frameSize, unsigned long nChans, unsigned long frameDelay)
 	{
 		unsigned long writePointer;
-		unsigned long readPointer;
+		long readPointer;
 		
 		// Sanity Check
 		
@@ -127,15 +335,15 @@ public:
 		
 		// Find output frame
 		
-		readPointer = mPointer - frameDelay;
-		readPointer = readPointer < 0 ? readPointer + mMaxNumFrames: readPointer;
-		readPointer = frameDelay > mValidFrames ? -1 : readPointer;
+		readPointer = (long) mPointer - (long) frameDelay;
+		readPointer = readPointer < 0 ? readPointer + (long) mMaxNumFrames : readPointer;
+		readPointer = (frameDelay > mValidFrames || frameDelay >= mMaxNumFrames) ? -1 : readPointer;
 		
 		for (unsigned long i = 0; i < nChans; i++) 
 			SingleChannelIO(in[i], out[i], mFrameData[i], frameSize, readPointer, writePointer);
 		
-		mPointer = ++mPointer >= mMaxNumFrames ? 0 : mPointer;
-		mValidFrames = ++mValidFrames >= mMaxNumFrames ? mMaxNumFrames : mValidFrames;
+		mPointer = (mPointer + 1) >= mMaxNumFrames ? 0 : mPointer + 1;
+		mValidFrames = (mValidFrames + 1) >= mMaxNumFrames ? mMaxNumFrames : mValidFrames + 1;
 		
 		return TRUE;
 	}
@@ -153,11 +361,131 @@ public:
 	}
 
 	
+	FrameDelayStorage getStorage()
+	{
+		return mStorage;
+	}
+	
+	
+	unsigned long getMemorySize()
+	{
+		return mMaxChans * mMaxNumFrames * mMaxFrameSize * mBytesPerValue;
+	}
+
+
+	// State
+	
+	unsigned long getStateSize()
+	{
+		HISSTools_StateWriter writer;
+		writeState(writer);
+		return writer.getPosition();
+	}
+	
+	
+	bool saveState(void *data, unsigned long size)
+	{
+		HISSTools_StateWriter writer(data, size);
+		writeState(writer);
+		return writer.isValid();
+	}
+	
+	
+	bool restoreState(const void *data, unsigned long size)
+	{
+		HISSTools_StateReader reader(data, size);
+		return readState(reader);
+	}
+	
+	
+	void writeState(HISSTools_StateWriter& writer)
+	{
+		// Only valid frames are stored (in their encoded form) - these always occupy the first slots
+		
+		unsigned long position = writer.beginState(kStateTagFrameDelay, kStateVersion);
+		unsigned long frameBytes = mMaxFrameSize * mBytesPerValue;
+		unsigned long nFrames = mClear == TRUE ? 0 : mValidFrames;
+		
+		writer.write(mStorage);
+		writer.write(mMaxFrameSize);
+		writer.write(mMaxNumFrames);
+		writer.write(mMaxChans);
+		writer.write(mClear);
+		writer.write(mFrameSize);
+		writer.write(mValidFrames);
+		writer.write(mPointer);
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			for (unsigned long j = 0; j < nFrames; j++)
+				writer.write(mFrameData[i] + j * frameBytes, mFrameSize * mBytesPerValue);
+		
+		writer.endState(position);
+	}
+	
+	
+	bool readState(HISSTools_StateReader& reader)
+	{
+		// The storage and maximums must match (nothing is restored otherwise)
+		
+		unsigned long frameBytes = mMaxFrameSize * mBytesPerValue;
+		unsigned long frameSize = 0;
+		unsigned long validFrames = 0;
+		unsigned long pointer = 0;
+		bool clear = TRUE;
+		
+		if (reader.beginState(kStateTagFrameDelay, kStateVersion) == FALSE)
+			return FALSE;
+		if (reader.check(mStorage) == FALSE || reader.check(mMaxFrameSize) == FALSE || reader.check(mMaxNumFrames) == FALSE || reader.check(mMaxChans) == FALSE)
+			return FALSE;
+		
+		reader.read(clear);
+		reader.read(frameSize);
+		reader.read(validFrames);
+		reader.read(pointer);
+		
+		if (reader.isValid() == FALSE)
+			return FALSE;
+		
+		unsigned long nFrames = clear == TRUE ? 0 : validFrames;
+		
+		if (frameSize > mMaxFrameSize || validFrames > mMaxNumFrames || pointer >= mMaxNumFrames)
+			return FALSE;
+		if (reader.canRead(mMaxChans * nFrames * frameSize * mBytesPerValue) == FALSE)
+			return FALSE;
+		
+		mClear = clear;
+		mFrameSize = frameSize;
+		mValidFrames = validFrames;
+		mPointer = pointer;
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			for (unsigned long j = 0; j < nFrames; j++)
+				reader.read(mFrameData[i] + j * frameBytes, mFrameSize * mBytesPerValue);
+		
+		return reader.isValid();
+	}
+
+
 private:
+
+	// Log Magnitude Quantisation (32766 steps over 128 octaves)
+	
+	static constexpr double kLogMagnitudeRange = 64.0;
+	static constexpr double kLogMagnitudeMin = 5.421010862427522e-20;
+	static constexpr double kLogMagnitudeScale = 32766.0 / 128.0;
+	
+	// State Version
+	
+	static const uint32_t kStateVersion = 1;
 	
 	// Data
 	
-	double **mFrameData;
+	unsigned char **mFrameData;
+	
+	// Storage
+	
+	const FrameDelayStorage mStorage;
+	unsigned long mBytesPerValue;
 	
 	// Current Parameters
 	
@@ -177,4 +505,4 @@ private:
 };
 
 
-#endif
\ No newline at end of file
+#endif
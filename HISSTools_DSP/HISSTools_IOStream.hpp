@@ -3,11 +3,13 @@
 #ifndef __HISSTOOLS_IOSTREAM__
 #define __HISSTOOLS_IOSTREAM__
 
+#include "../HISSTools_Utility/HISSTools_State.hpp"
 
 class HISSTools_IOStream {
     
 public:
 	enum IOStreamMode {kInput, kOutput};
+    enum IOStreamInterpolation {kInterpLinear, kInterpCubic};
     
 
 	HISSTools_IOStream(IOStreamMode mode, unsigned long size, unsigned long nChans) : mMode(mode), mBufferSize(std::max(1UL, size)),
@@ -15,6 +17,7 @@ public:
 	{
 		mBufferCounter = 0;
         mWriteOffset = mBufferSize;
+        mReadPhase = 0.0;
         
         // Allocate individual channel pointers
 		
@@ -52,9 +55,10 @@ public:
             memset(mBuffers[i], 0, mBufferSize * sizeof(double));
         
         mWriteOffset = mBufferSize;
+        mReadPhase = 0.0;
 	}
 	
-    bool read(double **outputs, unsigned long nChans, unsigned long size, unsigned long outputOffset)
+    bool read(double **outputs, unsigned long nChans, unsigned long size, unsigned long outputOffset, unsigned long *nValid = NULL)
     {
         // Load read and write parameters locally - FIX (check the effect of this later)...
         
@@ -63,46 +67,123 @@ public:
         
         double *output;
         
-        // Sanity check (cannot read more than has been written or more channels than stored)
-    
-        // FIX - read zeros if not enough written in output mode....
+        // Sanity check (cannot read more than is stored in input mode or more channels than stored)
         
-        if (size > writeOffset || nChans > mNChans)
+        if ((mMode == kInput && size > mBufferSize) || nChans > mNChans)
             return FALSE;
-    
+        
         // Adjust read counter if in input mode
         
         if (mMode == kInput)
             readCounter = (readCounter < size) ? mBufferSize + readCounter - size : readCounter - size;
         
+        // In output mode only the samples written are valid (the remainder is zero filled)
+        
+        unsigned long validSize = (mMode == kOutput && size > writeOffset) ? writeOffset : size;
+        
         // Check for wraparound and copy in one or two steps
         
         unsigned long bufferRemain = mBufferSize - readCounter;
-        unsigned long unwrappedSize = bufferRemain > size ? size : bufferRemain;
+        unsigned long unwrappedSize = bufferRemain > validSize ? validSize : bufferRemain;
         
         for (unsigned long i = 0; i < nChans; i++)
         {
             output = outputs[i] + outputOffset;
             
             memcpy((void *) output, (void *) (mBuffers[i] + readCounter), unwrappedSize * sizeof (double));
-            memcpy((void *) (output + unwrappedSize), mBuffers[i], (size - unwrappedSize) * sizeof (double));
+            memcpy((void *) (output + unwrappedSize), mBuffers[i], (validSize - unwrappedSize) * sizeof (double));
+            memset((void *) (output + validSize), 0, (size - validSize) * sizeof (double));
         }
         
         // Update counter / offset if in output mode
         
         if (mMode == kOutput)
         {
-            readCounter += size;
-            mBufferCounter = (readCounter < mBufferSize) ? readCounter : readCounter - mBufferSize;
-            mWriteOffset = writeOffset - size;
+            mBufferCounter = (unsigned long) ((readCounter + (unsigned long long) size) % mBufferSize);
+            mWriteOffset = writeOffset - validSize;
+            mReadPhase = 0.0;
         }
         
+        if (nValid)
+            *nValid = validSize;
+        
         return TRUE;
     }
     
-    bool read(double *output, unsigned long size, unsigned long outputOffset)
+    bool readInterpolated(double **outputs, unsigned long nChans, unsigned long size, unsigned long outputOffset, double rate, IOStreamInterpolation interp = kInterpLinear, unsigned long *nValid = NULL)
     {
-        return read(&output, 1UL, size, outputOffset);
+        // Output mode only - reads size samples stepping by rate (in stored samples) from the current (fractional) read position
+        // The samples passed over are consumed, and the fractional part of the position is kept for the next read
+        // Samples beyond those written read as zero - nValid reports how many outputs were calculated only from written samples
+        
+        unsigned long readCounter = mBufferCounter;
+        unsigned long writeOffset = mWriteOffset;
+        unsigned long lookahead = interp == kInterpCubic ? 2 : 1;
+        unsigned long validSize = size;
+        
+        double *output;
+        double position = mReadPhase;
+        
+        // Sanity check
+        
+        if (mMode != kOutput || nChans > mNChans || rate <= 0.0)
+            return FALSE;
+        
+        for (unsigned long i = 0; i < nChans; i++)
+        {
+            output = outputs[i] + outputOffset;
+            position = mReadPhase;
+            
+            for (unsigned long j = 0; j < size; j++, position += rate)
+            {
+                unsigned long index = (unsigned long) position;
+                double fract = position - index;
+                double x0 = getSample(i, readCounter, writeOffset, index);
+                double x1 = getSample(i, readCounter, writeOffset, index + 1);
+                
+                if (j < validSize && index + lookahead >= writeOffset)
+                    validSize = j;
+                
+                if (interp == kInterpCubic)
+                {
+                    double xm1 = getSample(i, readCounter, writeOffset, index - 1);
+                    double x2 = getSample(i, readCounter, writeOffset, index + 2);
+                    
+                    // Catmull-Rom (4 point, 3rd order Hermite)
+                    
+                    double c1 = 0.5 * (x1 - xm1);
+                    double c2 = xm1 - 2.5 * x0 + 2.0 * x1 - 0.5 * x2;
+                    double c3 = 0.5 * (x2 - xm1) + 1.5 * (x0 - x1);
+                    
+                    output[j] = ((c3 * fract + c2) * fract + c1) * fract + x0;
+                }
+                else
+                    output[j] = x0 + fract * (x1 - x0);
+            }
+        }
+        
+        // Consume the samples passed over
+        
+        unsigned long consumed = (unsigned long) position;
+        
+        mBufferCounter = (unsigned long) ((readCounter + (unsigned long long) consumed) % mBufferSize);
+        mWriteOffset = consumed > writeOffset ? 0 : writeOffset - consumed;
+        mReadPhase = position - consumed;
+        
+        if (nValid)
+            *nValid = validSize;
+        
+        return TRUE;
+    }
+    
+    bool read(double *output, unsigned long size, unsigned long outputOffset, unsigned long *nValid = NULL)
+    {
+        return read(&output, 1UL, size, outputOffset, nValid);
+    }
+    
+    bool readInterpolated(double *output, unsigned long size, unsigned long outputOffset, double rate, IOStreamInterpolation interp = kInterpLinear, unsigned long *nValid = NULL)
+    {
+        return readInterpolated(&output, 1UL, size, outputOffset, rate, interp, nValid);
     }
 	
 	bool write(double **inputs, unsigned long nChans, unsigned long size, unsigned long inputOffset)
@@ -174,8 +255,95 @@ public:
         return write(&input, 1, size, inputOffset);
     }
 
+    // State
+    
+    unsigned long getStateSize()
+    {
+        HISSTools_StateWriter writer;
+        writeState(writer);
+        return writer.getPosition();
+    }
+    
+    bool saveState(void *data, unsigned long size)
+    {
+        HISSTools_StateWriter writer(data, size);
+        writeState(writer);
+        return writer.isValid();
+    }
+    
+    bool restoreState(const void *data, unsigned long size)
+    {
+        HISSTools_StateReader reader(data, size);
+        return readState(reader);
+    }
+    
+    void writeState(HISSTools_StateWriter& writer)
+    {
+        unsigned long position = writer.beginState(kStateTagIOStream, kStateVersion);
+        
+        writer.write(mMode);
+        writer.write(mBufferSize);
+        writer.write(mNChans);
+        writer.write(mBufferCounter);
+        writer.write(mWriteOffset);
+        writer.write(mReadPhase);
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            writer.write(mBuffers[i], mBufferSize);
+        
+        writer.endState(position);
+    }
+    
+    bool readState(HISSTools_StateReader& reader)
+    {
+        // The state must come from a stream with the same mode, size and channels (the size of the state is then fixed)
+        
+        if (reader.beginState(kStateTagIOStream, kStateVersion, getStateSize()) == FALSE)
+            return FALSE;
+        if (reader.check(mMode) == FALSE || reader.check(mBufferSize) == FALSE || reader.check(mNChans) == FALSE)
+            return FALSE;
+        
+        // The counter indexes the buffers and the offset is at most the buffer size (nothing is restored if either is out of range)
+        
+        unsigned long bufferCounter = 0;
+        unsigned long writeOffset = 0;
+        
+        reader.read(bufferCounter);
+        reader.read(writeOffset);
+        
+        if (reader.isValid() == FALSE || bufferCounter >= mBufferSize || writeOffset > mBufferSize)
+            return FALSE;
+        
+        mBufferCounter = bufferCounter;
+        mWriteOffset = writeOffset;
+        
+        reader.read(mReadPhase);
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            reader.read(mBuffers[i], mBufferSize);
+        
+        return reader.isValid();
+    }
+
 
 private:
+
+    static const uint32_t kStateVersion = 1;
+    
+    double getSample(unsigned long chan, unsigned long readCounter, unsigned long writeOffset, unsigned long index)
+    {
+        // Index is relative to the read counter (an index of -1 wraps to the last sample read)
+        // When the buffer is full that slot holds the newest sample written, so the oldest valid sample is used instead
+        
+        if (index == (unsigned long) -1 && writeOffset >= mBufferSize)
+            index = 0;
+        
+        if (index != (unsigned long) -1 && index >= writeOffset)
+            return 0.0;
+        
+        return mBuffers[chan][(unsigned long) ((readCounter + (unsigned long long) index + mBufferSize) % mBufferSize)];
+    }
+    
 	
     // Mode
     
@@ -189,6 +357,10 @@ private:
 	
 	unsigned long mBufferCounter;
 	unsigned long mWriteOffset;
+    
+    // Fractional Read Position
+    
+    double mReadPhase;
 	
 	// Sizes
 	
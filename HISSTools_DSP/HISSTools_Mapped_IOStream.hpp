@@ -0,0 +1,605 @@
+
+
+#ifndef __HISSTOOLS_MAPPED_IOSTREAM__
+#define __HISSTOOLS_MAPPED_IOSTREAM__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+// File-backed input stream (float storage) for histories too long to keep in memory
+//
+// Each channel is a ring in a memory-mapped file (a temporary file that is deleted on close, unless a path is given)
+// A background thread keeps the pages around the write position resident - prefaulted and locked ahead, flushed and unlocked behind
+// The audio thread writes and reads recent samples only within this resident window, so it never waits on the disk
+// Writes beyond the pages made resident so far are dropped (see getUnderruns()) rather than faulting
+// The stream still advances over a dropped block, so later samples keep their times and the gap reads as zero
+// Older history is read with readHistory() from one other thread, which drops the pages it has read from the cache (where supported)
+// so that long scans do not evict the pages that the audio thread is using
+
+class HISSTools_Mapped_IOStream {
+
+public:
+
+    HISSTools_Mapped_IOStream(unsigned long long size, unsigned long nChans, unsigned long residentSize = 65536, const char *path = NULL) :
+        mNChans(std::max(1UL, std::min(256UL, nChans)))
+    {
+        // The resident window (ahead and behind the write position) is limited to a quarter of the ring
+        
+        mBufferSize = std::max(size, 4ULL);
+        mResidentSize = (unsigned long) std::max(1ULL, std::min((unsigned long long) residentSize, mBufferSize >> 2));
+        mPageSize = getPageSize();
+        mChannelBytes = ((mBufferSize * sizeof(float) + mPageSize - 1) / mPageSize) * mPageSize;
+        
+        mBufferCounter = 0;
+        mWritten.store(0, std::memory_order_relaxed);
+        mUnderruns.store(0, std::memory_order_relaxed);
+        mExit.store(FALSE, std::memory_order_relaxed);
+        mThread = NULL;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            mBuffers[i] = NULL;
+        
+        if (openMapping(path, mChannelBytes * mNChans) == FALSE)
+            return;
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+            mBuffers[i] = (float *) (mMapping + i * mChannelBytes);
+        
+        // Make the first window resident before the audio thread writes to it
+        
+        pageRange(0, mResidentSize, kPagePrefetch);
+        mPrefetched.store(mResidentSize, std::memory_order_release);
+        mReleased = 0;
+        
+        mThread = new std::thread(&HISSTools_Mapped_IOStream::residentThread, this);
+    }
+    
+    ~HISSTools_Mapped_IOStream()
+    {
+        if (mThread)
+        {
+            mExit.store(TRUE, std::memory_order_release);
+            mThread->join();
+            delete mThread;
+        }
+        
+        closeMapping();
+    }
+    
+    bool isValid()
+    {
+        return mThread != NULL;
+    }
+    
+    unsigned long long getBufferSize()
+    {
+        return mBufferSize;
+    }
+    
+    unsigned long getNChans()
+    {
+        return mNChans;
+    }
+    
+    unsigned long getResidentSize()
+    {
+        return mResidentSize;
+    }
+    
+    unsigned long long getWritten()
+    {
+        // Samples written since construction (safe to call from any thread)
+        
+        return mWritten.load(std::memory_order_acquire);
+    }
+    
+    unsigned long long getUnderruns()
+    {
+        // Blocks dropped because the background thread had not yet made the pages resident
+        
+        return mUnderruns.load(std::memory_order_relaxed);
+    }
+    
+    unsigned long long getHistorySize()
+    {
+        // Samples of history that can be read (the ring, less the resident window ahead of the write position)
+        
+        return std::min(getWritten(), mBufferSize - mResidentSize);
+    }
+    
+    // Audio Thread
+    
+    bool write(double **inputs, unsigned long nChans, unsigned long size, unsigned long inputOffset)
+    {
+        // Writes only touch pages that the background thread has made resident
+        // If it has fallen behind (under load or when rendering faster than realtime) the block is dropped and counted as an underrun
+        // The write position still advances, so the dropped samples read as zero and the history stays aligned in time
+        
+        unsigned long long writeCounter = mBufferCounter;
+        unsigned long long written = mWritten.load(std::memory_order_relaxed);
+        
+        if (!isValid() || size > mResidentSize || nChans > mNChans)
+            return FALSE;
+        
+        bool resident = written + size <= mPrefetched.load(std::memory_order_acquire);
+        
+        if (resident)
+        {
+            unsigned long loop = (unsigned long) std::min((unsigned long long) size, mBufferSize - writeCounter);
+            
+            for (unsigned long i = 0; i < nChans; i++)
+            {
+                const double *input = inputs[i] + inputOffset;
+                float *buffer = mBuffers[i];
+                unsigned long j;
+                
+                for (j = 0; j < loop; j++)
+                    buffer[writeCounter + j] = (float) input[j];
+                
+                for (; j < size; j++)
+                    buffer[j - loop] = (float) input[j];
+            }
+        }
+        else
+            mUnderruns.store(mUnderruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        
+        writeCounter += size;
+        mBufferCounter = writeCounter < mBufferSize ? writeCounter : writeCounter - mBufferSize;
+        mWritten.store(written + size, std::memory_order_release);
+        
+        return resident;
+    }
+    
+    bool write(double *input, unsigned long size, unsigned long inputOffset)
+    {
+        return write(&input, 1, size, inputOffset);
+    }
+    
+    bool read(double **outputs, unsigned long nChans, unsigned long size, unsigned long outputOffset)
+    {
+        // Reads the most recent samples (up to the resident size, so that only resident pages are touched)
+        // Samples before the start of the stream, or dropped beyond the resident pages, read as zero (their pages may not be resident)
+        
+        if (!isValid() || size > mResidentSize || nChans > mNChans)
+            return FALSE;
+        
+        unsigned long long written = mWritten.load(std::memory_order_relaxed);
+        unsigned long long start = written > size ? written - size : 0;
+        unsigned long long end = std::min(written, mPrefetched.load(std::memory_order_acquire));
+        unsigned long leading = (unsigned long) (size - (written - start));
+        unsigned long valid = end > start ? (unsigned long) (end - start) : 0;
+        
+        for (unsigned long i = 0; i < nChans; i++)
+        {
+            std::fill_n(outputs[i] + outputOffset, leading, 0.0);
+            std::fill_n(outputs[i] + outputOffset + leading + valid, size - leading - valid, 0.0);
+        }
+        
+        copyOut(outputs, nChans, start % mBufferSize, valid, outputOffset + leading);
+        
+        return TRUE;
+    }
+    
+    bool read(double *output, unsigned long size, unsigned long outputOffset)
+    {
+        return read(&output, 1UL, size, outputOffset);
+    }
+    
+    // Analysis Thread
+    
+    bool readHistory(double **outputs, unsigned long nChans, unsigned long size, unsigned long long delay)
+    {
+        // Reads size samples ending delay samples before the current write position (call from one non-audio thread only)
+        // Returns FALSE if the samples are not (or are no longer) in the history - samples before the start of the stream read as zero
+        
+        unsigned long long written = getWritten();
+        
+        if (!isValid() || nChans > mNChans || delay > written || delay + size > mBufferSize - mResidentSize)
+            return FALSE;
+        
+        unsigned long long end = written - delay;
+        unsigned long long start = end > size ? end - size : 0;
+        unsigned long zeros = (unsigned long) (size - (end - start));
+        
+        // Samples dropped beyond the pages made resident so far have not yet been cleared, so read them as zero here
+        
+        unsigned long long cleared = std::max(start, std::min(end, mPrefetched.load(std::memory_order_acquire)));
+        
+        for (unsigned long i = 0; i < nChans; i++)
+        {
+            std::fill_n(outputs[i], zeros, 0.0);
+            std::fill_n(outputs[i] + zeros + (unsigned long) (cleared - start), (unsigned long) (end - cleared), 0.0);
+        }
+        
+        end = cleared;
+        
+        // Read in chunks, dropping each chunk from the cache unless it is within (or about to enter) the resident window
+        
+        for (unsigned long long chunk = start; chunk < end; chunk += kHistoryChunk)
+        {
+            unsigned long long chunkEnd = std::min(end, chunk + kHistoryChunk);
+            
+            copyOut(outputs, nChans, chunk % mBufferSize, (unsigned long) (chunkEnd - chunk), zeros + (unsigned long) (chunk - start));
+            
+            written = getWritten();
+            
+            if (chunkEnd + mResidentSize < written && chunk + mBufferSize > written + 2 * mResidentSize)
+                pageRange(chunk, chunkEnd, kPageDrop);
+        }
+        
+        // Check that the audio thread has not overwritten the start of the read (allowing for a write in progress)
+        
+        return start + mBufferSize >= getWritten() + mResidentSize;
+    }
+    
+    bool readHistory(double *output, unsigned long size, unsigned long long delay)
+    {
+        return readHistory(&output, 1UL, size, delay);
+    }
+
+
+private:
+
+    enum PageAction {kPagePrefetch, kPageRelease, kPageDrop};
+    
+    static const unsigned long kHistoryChunk = 16384;
+    
+    void copyOut(double **outputs, unsigned long nChans, unsigned long long readCounter, unsigned long size, unsigned long outputOffset)
+    {
+        unsigned long loop = (unsigned long) std::min((unsigned long long) size, mBufferSize - readCounter);
+        
+        for (unsigned long i = 0; i < nChans; i++)
+        {
+            double *output = outputs[i] + outputOffset;
+            const float *buffer = mBuffers[i];
+            unsigned long j;
+            
+            for (j = 0; j < loop; j++)
+                output[j] = buffer[readCounter + j];
+            
+            for (; j < size; j++)
+                output[j] = buffer[j - loop];
+        }
+    }
+    
+    void residentThread()
+    {
+        // The window ahead and behind never overlap (each is at most a quarter of the ring)
+        
+        unsigned long long pageSamples = mPageSize / sizeof(float);
+        
+        while (mExit.load(std::memory_order_acquire) == FALSE)
+        {
+            unsigned long long written = getWritten();
+            unsigned long long ahead = written + mResidentSize;
+            unsigned long long behind = written > mResidentSize ? written - mResidentSize : 0;
+            unsigned long long oldest = ahead > mBufferSize ? ahead - mBufferSize : 0;
+            
+            unsigned long long prefetched = mPrefetched.load(std::memory_order_relaxed);
+            
+            // Samples ahead are cleared before they are published (they are older than the history, and any dropped by an underrun read as zero)
+            
+            if (ahead > prefetched)
+            {
+                pageRange(std::max(prefetched, written), ahead, kPagePrefetch);
+                clearRange(std::max(prefetched, oldest), ahead);
+                mPrefetched.store(ahead, std::memory_order_release);
+            }
+            
+            // Release up to the last page boundary (in the ring) behind, as only wholly covered pages are released
+            // Each call then covers whole pages even when less than a page has been written since the last one
+            
+            unsigned long long release = behind - (behind % mBufferSize) % pageSamples;
+            
+            if (release > mReleased)
+            {
+                pageRange(std::max(mReleased, oldest), release, kPageRelease);
+                mReleased = release;
+            }
+            
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    
+    void clearRange(unsigned long long start, unsigned long long end)
+    {
+        // Zero the samples of each channel from start to end (wrapping around the ring)
+        
+        unsigned long long position = start % mBufferSize;
+        unsigned long long length = std::min(end - start, mBufferSize);
+        unsigned long long first = std::min(length, mBufferSize - position);
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+        {
+            std::fill_n(mBuffers[i] + position, first, 0.f);
+            std::fill_n(mBuffers[i], length - first, 0.f);
+        }
+    }
+    
+    void pageRange(unsigned long long start, unsigned long long end, PageAction action)
+    {
+        // Apply an action to the pages of each channel holding samples from start to end (wrapping around the ring)
+        // A range reaching the end of the ring covers the rest of its last page (the padding after the final sample)
+        
+        unsigned long long position = start % mBufferSize;
+        unsigned long long length = std::min(end - start, mBufferSize);
+        unsigned long long first = std::min(length, mBufferSize - position);
+        unsigned long long firstBytes = position + first == mBufferSize ? mChannelBytes - position * sizeof(float) : first * sizeof(float);
+        
+        for (unsigned long i = 0; i < mNChans; i++)
+        {
+            pageAction(i * mChannelBytes + position * sizeof(float), firstBytes, action);
+            
+            if (length > first)
+                pageAction(i * mChannelBytes, (length - first) * sizeof(float), action);
+        }
+    }
+    
+    void pageAction(unsigned long long offset, unsigned long long bytes, PageAction action)
+    {
+        // Pages are prefetched if partly covered, but only released when wholly covered (so the window edges stay resident)
+        
+        unsigned long long lo, hi;
+        
+        if (action == kPageRelease)
+        {
+            lo = ((offset + mPageSize - 1) / mPageSize) * mPageSize;
+            hi = ((offset + bytes) / mPageSize) * mPageSize;
+        }
+        else
+        {
+            lo = (offset / mPageSize) * mPageSize;
+            hi = ((offset + bytes + mPageSize - 1) / mPageSize) * mPageSize;
+        }
+        
+        if (hi <= lo)
+            return;
+        
+        unsigned char *address = mMapping + lo;
+        size_t length = (size_t) (hi - lo);
+        
+        switch (action)
+        {
+            case kPagePrefetch:
+                prefaultPages(address, length);
+                lockPages(address, length);
+                break;
+            
+            case kPageRelease:
+                unlockPages(address, length);
+                flushPages(address, length);
+                break;
+            
+            case kPageDrop:
+                dropPages(address, lo, length);
+                break;
+        }
+    }
+    
+    void touchPages(unsigned char *address, size_t length)
+    {
+        // Pages are only read (the audio thread may be writing to the start of the range)
+        
+        for (size_t j = 0; j < length; j += mPageSize)
+            (void) *((volatile unsigned char *) address + j);
+    }
+    
+    // Platform Specific
+
+#ifdef _WIN32
+
+    static size_t getPageSize()
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return info.dwPageSize;
+    }
+    
+    bool openMapping(const char *path, unsigned long long bytes)
+    {
+        char tempPath[MAX_PATH];
+        char tempName[MAX_PATH];
+        
+        mMapping = NULL;
+        mMap = NULL;
+        mFile = INVALID_HANDLE_VALUE;
+        
+        if (!path && GetTempPathA(MAX_PATH, tempPath) && GetTempFileNameA(tempPath, "HIS", 0, tempName))
+            mFile = CreateFileA(tempName, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+        else if (path)
+            mFile = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        
+        if (mFile == INVALID_HANDLE_VALUE)
+            return FALSE;
+        
+        mMap = CreateFileMappingA(mFile, NULL, PAGE_READWRITE, (DWORD) (bytes >> 32), (DWORD) (bytes & 0xFFFFFFFFULL), NULL);
+        
+        if (mMap)
+            mMapping = (unsigned char *) MapViewOfFile(mMap, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T) bytes);
+        
+        mMappingBytes = bytes;
+        
+        return mMapping != NULL;
+    }
+    
+    void closeMapping()
+    {
+        if (mMapping)
+        {
+            unlockPages(mMapping, (size_t) mMappingBytes);
+            FlushViewOfFile(mMapping, 0);
+            UnmapViewOfFile(mMapping);
+        }
+        
+        if (mMap)
+            CloseHandle(mMap);
+        if (mFile != INVALID_HANDLE_VALUE)
+            CloseHandle(mFile);
+    }
+    
+    void prefaultPages(unsigned char *address, size_t length)
+    {
+        touchPages(address, length);
+    }
+    
+    static void lockPages(unsigned char *address, size_t length)
+    {
+        VirtualLock(address, length);
+    }
+    
+    static void unlockPages(unsigned char *address, size_t length)
+    {
+        VirtualUnlock(address, length);
+    }
+    
+    static void flushPages(unsigned char *address, size_t length)
+    {
+        FlushViewOfFile(address, length);
+    }
+    
+    void dropPages(unsigned char *address, unsigned long long offset, size_t length)
+    {
+        // No equivalent of dropping clean pages from the cache
+    }
+
+#else
+
+    static size_t getPageSize()
+    {
+        long pageSize = sysconf(_SC_PAGESIZE);
+        return pageSize > 0 ? (size_t) pageSize : 4096;
+    }
+    
+    bool openMapping(const char *path, unsigned long long bytes)
+    {
+        char tempName[] = "/tmp/HISSTools_XXXXXX";
+        
+        mMapping = NULL;
+        mMappingBytes = bytes;
+        mFile = path ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : mkstemp(tempName);
+        
+        if (mFile == -1)
+            return FALSE;
+        
+        // A temporary file is unlinked immediately (so that it is removed however the process ends)
+        
+        if (!path)
+            unlink(tempName);
+        
+        if (ftruncate(mFile, (off_t) bytes))
+            return FALSE;
+        
+        void *mapping = mmap(NULL, (size_t) bytes, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+        
+        mMapping = mapping == MAP_FAILED ? NULL : (unsigned char *) mapping;
+        
+        return mMapping != NULL;
+    }
+    
+    void closeMapping()
+    {
+        if (mMapping)
+        {
+            munlock(mMapping, (size_t) mMappingBytes);
+            munmap(mMapping, (size_t) mMappingBytes);
+        }
+        
+        if (mFile != -1)
+            close(mFile);
+    }
+    
+    void prefaultPages(unsigned char *address, size_t length)
+    {
+        // Fault the pages in for writing without changing them where possible (otherwise the first write takes a minor fault)
+
+#ifdef MADV_POPULATE_WRITE
+        if (!madvise(address, length, MADV_POPULATE_WRITE))
+            return;
+#endif
+        touchPages(address, length);
+    }
+    
+    static void lockPages(unsigned char *address, size_t length)
+    {
+        mlock(address, length);
+    }
+    
+    static void unlockPages(unsigned char *address, size_t length)
+    {
+        munlock(address, length);
+    }
+    
+    static void flushPages(unsigned char *address, size_t length)
+    {
+        msync(address, length, MS_ASYNC);
+    }
+    
+    void dropPages(unsigned char *address, unsigned long long offset, size_t length)
+    {
+        // Unmap the pages (the data stays in the file) so that the clean ones can be dropped from the cache
+        // Pages not yet written back are left in the cache
+        
+        madvise(address, length, MADV_DONTNEED);
+
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(mFile, (off_t) offset, (off_t) length, POSIX_FADV_DONTNEED);
+#endif
+    }
+
+#endif
+
+    // Mapping
+
+#ifdef _WIN32
+    HANDLE mFile;
+    HANDLE mMap;
+#else
+    int mFile;
+#endif
+
+    unsigned char *mMapping;
+    unsigned long long mMappingBytes;
+    unsigned long long mChannelBytes;
+    size_t mPageSize;
+    
+    // Data
+    
+    float *mBuffers[256];
+    
+    // Pointers
+    
+    unsigned long long mBufferCounter;
+    std::atomic<unsigned long long> mWritten;
+    std::atomic<unsigned long long> mUnderruns;
+    
+    // Resident Window (published to the audio thread up to the end of the prefetched pages)
+    
+    std::atomic<unsigned long long> mPrefetched;
+    unsigned long long mReleased;
+    
+    std::thread *mThread;
+    std::atomic<bool> mExit;
+    
+    // Sizes
+    
+    unsigned long long mBufferSize;
+    unsigned long mResidentSize;
+    const unsigned long mNChans;
+};
+
+
+#endif
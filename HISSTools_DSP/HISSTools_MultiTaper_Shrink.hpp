@@ -4,6 +4,9 @@
 #define __HISSTools_MULTITAPER_SHRINK__
 
 
+#include <atomic>
+#include <thread>
+
 #include "HISSTools_FSpectrum.hpp"
 #include "HISSTools_MultiTaper_Spectrum.hpp"
 #include "HISSTools_DWT.hpp"
@@ -22,10 +25,9 @@ class HISSTools_MultiTaper_Shrink : protected HISSTools_MultiTaper_Spectrum, pro
 	
 public:
 	
-	HISSTools_MultiTaper_Shrink(unsigned long maxFFTSize, HISSTools_Wavelet *wavelet, PSpectrumFormat format = kSpectrumNyquist):
-	HISSTools_MultiTaper_Spectrum(maxFFTSize, kSpectrumFull), HISSTools_DWT(maxFFTSize), HISSTools_PSpectrum(maxFFTSize, kSpectrumFull)
+	HISSTools_MultiTaper_Shrink(unsigned long maxFFTSize, const HISSTools_Wavelet *wavelet, PSpectrumFormat format = kSpectrumNyquist):
+	HISSTools_MultiTaper_Spectrum(maxFFTSize, kSpectrumFull), HISSTools_DWT(maxFFTSize), HISSTools_PSpectrum(maxFFTSize, kSpectrumFull), mWavelet(wavelet), mWaveletUsers(0)
 	{			
-		mWavelet = wavelet;
 	}
 	
 	~HISSTools_MultiTaper_Shrink()
@@ -118,7 +120,42 @@ private:
 	
 public:
 	
+	void setWavelet(const HISSTools_Wavelet *wavelet)
+	{
+		// Safe to call from any thread - returns once no calculation is using the previous wavelet (which may then be freed)
+		// N.B. this may wait for a calculation in progress on another thread (so avoid calling it where that is not acceptable)
+		
+		mWavelet.store(wavelet);
+		
+		while (mWaveletUsers.load())
+			std::this_thread::yield();
+	}
+	
+	
+	const HISSTools_Wavelet *getWavelet()
+	{
+		return mWavelet.load(std::memory_order_acquire);
+	}
+	
+	
 	bool calcPowerSpectrum(double *samples, HISSTools_PSpectrum *outSpectrum, ShrinkTypes shrinkMethod, long kTapers, unsigned long shrinkLevel, unsigned long nSamps, unsigned long FFTSize = 0, double scale = 0., double samplingRate = 44100, unsigned long adaptIterations = 0)
+	{
+		// Load the wavelet once so that the forward and inverse transforms match (it is counted as in use until the calculation ends)
+		
+		mWaveletUsers++;
+		
+		const HISSTools_Wavelet *wavelet = mWavelet.load();
+		bool success = calcShrinkSpectrum(wavelet, samples, outSpectrum, shrinkMethod, kTapers, shrinkLevel, nSamps, FFTSize, scale, samplingRate, adaptIterations);
+		
+		mWaveletUsers--;
+		
+		return success;
+	}
+	
+	
+private:
+	
+	bool calcShrinkSpectrum(const HISSTools_Wavelet *wavelet, double *samples, HISSTools_PSpectrum *outSpectrum, ShrinkTypes shrinkMethod, long kTapers, unsigned long shrinkLevel, unsigned long nSamps, unsigned long FFTSize, double scale, double samplingRate, unsigned long adaptIterations)
 	{
 		HISSTools_PSpectrum *tempPowerSpectrum = this;
 		PSpectrumFormat format = outSpectrum->getFormat();
@@ -127,9 +164,9 @@ public:
 		double noiseMean = digamma(kTapers) - log(kTapers);
 		long i;
 		
-		// Fall back on Multitaper spectrum if no shrinking is required
+		// Fall back on Multitaper spectrum if no shrinking is required (or possible)
 		
-		if (shrinkLevel == 0)
+		if (shrinkLevel == 0 || !wavelet || !wavelet->isValid())
 			return HISSTools_MultiTaper_Spectrum::calcPowerSpectrum(samples, outSpectrum, kTapers, nSamps, FFTSize, scale, samplingRate, adaptIterations);
 		
 		// Put Multitaper spectrum in temporary PSpectrum (with Sanity Check)
@@ -157,7 +194,7 @@ public:
 		// Wavelet shrinking
 		// Transform
 			
-		forwardDWT(temp, FFTSize, shrinkLevel, mWavelet);
+		forwardDWT(temp, FFTSize, shrinkLevel, wavelet);
 			
 		// Wavelet Shrink
 			
@@ -165,7 +202,7 @@ public:
 			
 		// Transform Back
 			
-		inverseDWT(temp, FFTSize, shrinkLevel, mWavelet);
+		inverseDWT(temp, FFTSize, shrinkLevel, wavelet);
 		
 		// Average Results
 		// DC
@@ -191,9 +228,8 @@ public:
 	}
 	
 	
-private:
-	
-	HISSTools_Wavelet *mWavelet;	
+	std::atomic<const HISSTools_Wavelet *> mWavelet;
+	std::atomic<unsigned long> mWaveletUsers;
 	HISSTools_PSpectrum *mTempPowerSpectrum;
 };
 
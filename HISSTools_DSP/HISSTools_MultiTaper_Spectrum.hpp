@@ -5,6 +5,7 @@
 
 
 #include "HISSTools_FFT.hpp"
+#include "HISSTools_DPSS.hpp"
 
 
 class HISSTools_MultiTaper_Spectrum : protected HISSTools_FFT, protected HISSTools_FSpectrum 
@@ -14,10 +15,36 @@ public:
 	
 	HISSTools_MultiTaper_Spectrum (unsigned long maxFFTSize, PSpectrumFormat format = kSpectrumNyquist) : HISSTools_FFT(maxFFTSize * 2), HISSTools_FSpectrum(maxFFTSize * 2, kSpectrumComplex)
 	{		
+		mMaxFFTSize = maxFFTSize;
+		mTaperedSamples = new double[maxFFTSize];
+		mEigenSpectra = new double[HISSTools_DPSS::kMaxTapers * ((maxFFTSize >> 1) + 1)];
+		mDPSSSamps = 0;
+		mDPSSNW = 0.0;
+		mDPSSK = 0;
+		
+		mZoomChirpReal = NULL;
+		mZoomChirpImag = NULL;
+		mZoomPostReal = NULL;
+		mZoomPostImag = NULL;
+		mZoomFilterReal = NULL;
+		mZoomFilterImag = NULL;
+		mZoomReal = NULL;
+		mZoomImag = NULL;
+		mZoomTemp = NULL;
+		
+		mZoomSamps = 0;
+		mZoomFFTSize = 0;
+		mZoomConvSize = 0;
+		mZoomBins = 0;
+		mZoomTapers = 0;
 	}
 	
 	~HISSTools_MultiTaper_Spectrum()
 	{
+		delete[] mTaperedSamples;
+		delete[] mEigenSpectra;
+		
+		freeZoom();
 	}
 	
 private:
@@ -252,6 +279,447 @@ public:
 		return TRUE;
 	}
 
+	
+	// DPSS tapers must be prepared off the audio thread (this calculates and caches them, returning FALSE on failure)
+	// The taper set is held by the object, so that calculation does not lock or release memory (only the prepared set can be used)
+	
+	bool prepareDPSS(unsigned long nSamps, double NW, unsigned long kTapers)
+	{
+		HISSTools_RefPtr<double> tapers;
+		
+		if (nSamps > mMaxFFTSize)
+			return FALSE;
+		
+		tapers = HISSTools_DPSS::prepare(nSamps, NW, kTapers);
+		
+		if (!tapers.getSize())
+			return FALSE;
+		
+		mDPSSTapers = tapers;
+		mDPSSSamps = nSamps;
+		mDPSSNW = NW;
+		mDPSSK = kTapers;
+		
+		return TRUE;
+	}
+	
+	// One FFT per DPSS taper (of nSamps samples) - adaptIterations > 0 uses adaptive (Thomson) weighting of the eigenspectra
+	// N.B. The result is scaled to match the sine taper path above for the same input (and therefore includes the same sqrt(2) factor)
+	
+	bool calcPowerSpectrumDPSS(double *samples, HISSTools_PSpectrum *outSpectrum, double NW, unsigned long kTapers, unsigned long nSamps, unsigned long FFTSize = 0, double scale = 0., double samplingRate = 44100, unsigned long adaptIterations = 0)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *this->getSpectrum();
+		PSpectrumFormat format = outSpectrum->getFormat();
+		
+		double *spectrum = outSpectrum->getSpectrum();
+		double *taperedSamples = mTaperedSamples;
+		double *eigenSpectra = mEigenSpectra;
+		double *tapers;
+		double *concentrations;
+		double variance = 0.0;
+		double real, imag;
+		
+		unsigned long maxBin;
+		unsigned long i, j, k;
+		
+		// Check arguments (tapers must have been prepared for this size and the eigenspectra must fit)
+		
+		if (!mDPSSTapers.getSize() || nSamps != mDPSSSamps || NW != mDPSSNW || kTapers != mDPSSK)
+			return FALSE;
+		
+		if (FFTSize < nSamps)
+			FFTSize = nSamps;
+		
+		FFTSize = 1 << ((HISSTools_FFT *) this)->log2(FFTSize);
+		
+		if (FFTSize > mMaxFFTSize)
+			return FALSE;
+		
+		scale = scale == 0 ? 1 : scale;
+		tapers = mDPSSTapers.get();
+		concentrations = tapers + (nSamps * kTapers);
+		
+		// Attempt to set output size
+		
+		if (outSpectrum->setFFTSize(FFTSize) == FALSE)
+			return FALSE;
+		
+		maxBin = (FFTSize >> 1) + 1;
+		
+		// Eigenspectra (one FFT per taper)
+		
+		for (k = 0; k < kTapers; k++)
+		{
+			double *taper = tapers + (nSamps * k);
+			double *eigenSpectrum = eigenSpectra + (maxBin * k);
+			
+			for (i = 0; i < nSamps; i++)
+				taperedSamples[i] = samples[i] * taper[i];
+			
+			if (timeToSpectrum(taperedSamples, this, nSamps, FFTSize, samplingRate) == FALSE)
+				return FALSE;
+			
+			for (j = 0; j < maxBin; j++)
+			{
+				real = FFTData.realp[j];
+				imag = FFTData.imagp[j];
+				eigenSpectrum[j] = (real * real) + (imag * imag);
+			}
+		}
+		
+		// Initial estimate (equal weights)
+		
+		for (j = 0; j < maxBin; j++)
+			spectrum[j] = 0.;
+		
+		for (k = 0; k < kTapers; k++)
+			for (j = 0; j < maxBin; j++)
+				spectrum[j] += eigenSpectra[maxBin * k + j];
+		
+		for (j = 0; j < maxBin; j++)
+			spectrum[j] /= kTapers;
+		
+		// Adaptive weighting (each iteration reweights the eigenspectra against the previous estimate)
+		
+		if (adaptIterations)
+		{
+			for (i = 0; i < nSamps; i++)
+				variance += samples[i] * samples[i];
+			
+			variance /= nSamps;
+			
+			for (i = 0; i < adaptIterations; i++)
+			{
+				for (j = 0; j < maxBin; j++)
+				{
+					double estimate = spectrum[j];
+					double powerSum = 0.0;
+					double weightSum = 0.0;
+					
+					for (k = 0; k < kTapers; k++)
+					{
+						double lambda = concentrations[k];
+						double weight = sqrt(lambda) * estimate / (lambda * estimate + (1.0 - lambda) * variance);
+						
+						weight *= weight;
+						powerSum += weight * eigenSpectra[maxBin * k + j];
+						weightSum += weight;
+					}
+					
+					spectrum[j] = weightSum > 0.0 ? powerSum / weightSum : 0.0;
+				}
+			}
+		}
+		
+		for (j = 0; j < maxBin; j++)
+			spectrum[j] *= sqrt(2.) * scale;
+		
+		// Mirror second half of output spectrum if relevant
+		
+		if (format == kSpectrumFull)
+			for (j = maxBin; j < FFTSize; j++)
+				spectrum[j] = spectrum[FFTSize - j];
+		
+		setSamplingRate(samplingRate);
+		outSpectrum->setSamplingRate(samplingRate);
+		
+		return TRUE;
+	}
+	
+	
+	// Zoom analysis (sine tapers over a band of bins) using Bluestein's chirp-z transform
+	//
+	// The output matches bins startBin to startBin + nBins - 1 of calcPowerSpectrum() with the same FFTSize (same bin spacing and taper smoothing)
+	// Only the band (plus the taper overlap) is evaluated, so the cost depends on nSamps and nBins rather than on FFTSize
+	// FFTSize sets the bin spacing (samplingRate / FFTSize) and need not be a power of two
+	//
+	// The band is found as a convolution with a chirp of length nSamps + 2 * (nBins + kTapers) - 2 (rounded up to a power of two)
+	// This must fit in twice the maximum FFT size (so nSamps must be less than the maximum FFT size, but FFTSize can be much larger)
+	//
+	// N.B. prepareZoom() allocates memory and is not threadsafe
+	
+	bool prepareZoom(unsigned long nSamps, unsigned long FFTSize, unsigned long startBin, unsigned long nBins, unsigned long kTapers)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *this->getSpectrum();
+		
+		unsigned long nGrid = 2 * (nBins + kTapers) - 1;
+		unsigned long convSize = 1;
+		unsigned long i;
+		
+		freeZoom();
+		
+		// Check arguments
+		
+		if (!nSamps || !nBins || !kTapers || FFTSize < nSamps || kTapers >= (FFTSize >> 1) || startBin + nBins > (FFTSize >> 1) + 1)
+			return FALSE;
+		
+		while (convSize < nSamps + nGrid - 1)
+			convSize <<= 1;
+		
+		if (convSize > (mMaxFFTSize << 1))
+			return FALSE;
+		
+		mZoomChirpReal = new double[nSamps];
+		mZoomChirpImag = new double[nSamps];
+		mZoomPostReal = new double[nGrid];
+		mZoomPostImag = new double[nGrid];
+		mZoomFilterReal = new double[convSize];
+		mZoomFilterImag = new double[convSize];
+		mZoomReal = new double[convSize];
+		mZoomImag = new double[convSize];
+		mZoomTemp = new double[convSize];
+		
+		// The grid runs in half bin steps from kTapers half bins below the band (as the tapers are formed from pairs of half bins)
+		// Phases are reduced exactly (in integers) before conversion, so that long chirps remain accurate
+		
+		long long period = 4 * (long long) FFTSize;
+		long long offset = 2 * (long long) startBin - (long long) kTapers;
+		double phaseScale = M_PI / (2.0 * FFTSize);
+		
+		for (i = 0; i < nSamps; i++)
+		{
+			long long n = i;
+			long long phase = ((n * n + 2 * offset * n) % period + period) % period;
+			
+			mZoomChirpReal[i] = cos(phaseScale * phase);
+			mZoomChirpImag[i] = -sin(phaseScale * phase);
+		}
+		
+		for (i = 0; i < nGrid; i++)
+		{
+			long long n = i;
+			long long phase = (n * n) % period;
+			
+			mZoomPostReal[i] = cos(phaseScale * phase);
+			mZoomPostImag[i] = -sin(phaseScale * phase);
+		}
+		
+		// Chirp filter (circular, so that the convolution covers all samples for every grid point)
+		
+		for (i = 0; i < convSize; i++)
+		{
+			long long n = i < nGrid ? i : (i > convSize - nSamps ? convSize - i : 0);
+			long long phase = (n * n) % period;
+			bool used = i < nGrid || i > convSize - nSamps;
+			
+			mZoomReal[i] = used ? cos(phaseScale * phase) : 0.0;
+			mZoomImag[i] = used ? sin(phaseScale * phase) : 0.0;
+		}
+		
+		// Transform the real and imaginary parts and combine them
+		
+		if (timeToSpectrum(mZoomReal, this, convSize, convSize, 1.0) == FALSE)
+		{
+			freeZoom();
+			return FALSE;
+		}
+		
+		for (i = 0; i < convSize; i++)
+		{
+			mZoomFilterReal[i] = FFTData.realp[i];
+			mZoomFilterImag[i] = FFTData.imagp[i];
+		}
+		
+		if (timeToSpectrum(mZoomImag, this, convSize, convSize, 1.0) == FALSE)
+		{
+			freeZoom();
+			return FALSE;
+		}
+		
+		for (i = 0; i < convSize; i++)
+		{
+			mZoomFilterReal[i] -= FFTData.imagp[i];
+			mZoomFilterImag[i] += FFTData.realp[i];
+		}
+		
+		mZoomSamps = nSamps;
+		mZoomFFTSize = FFTSize;
+		mZoomConvSize = convSize;
+		mZoomBins = nBins;
+		mZoomTapers = kTapers;
+		
+		return TRUE;
+	}
+	
+	// Calculate the band set by prepareZoom() (spectrum should have space for nBins values)
+	
+	bool calcZoomPowerSpectrum(double *samples, double *spectrum, double scale = 0., double samplingRate = 44100)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *this->getSpectrum();
+		
+		unsigned long convSize = mZoomConvSize;
+		unsigned long kTapers = mZoomTapers;
+		unsigned long nGrid = 2 * (mZoomBins + kTapers) - 1;
+		unsigned long i, j;
+		
+		double *gridReal = mZoomTemp;
+		double *gridImag = mZoomReal;
+		double real, imag;
+		
+		if (!mZoomBins)
+			return FALSE;
+		
+		scale = scale == 0 ? 1 : scale;
+		
+		// Spectrum of the chirped samples (the real and imaginary parts are transformed separately)
+		
+		for (i = 0; i < mZoomSamps; i++)
+			mZoomTemp[i] = samples[i] * mZoomChirpReal[i];
+		
+		if (timeToSpectrum(mZoomTemp, this, mZoomSamps, convSize, samplingRate) == FALSE)
+			return FALSE;
+		
+		for (i = 0; i < convSize; i++)
+		{
+			mZoomReal[i] = FFTData.realp[i];
+			mZoomImag[i] = FFTData.imagp[i];
+		}
+		
+		for (i = 0; i < mZoomSamps; i++)
+			mZoomTemp[i] = samples[i] * mZoomChirpImag[i];
+		
+		if (timeToSpectrum(mZoomTemp, this, mZoomSamps, convSize, samplingRate) == FALSE)
+			return FALSE;
+		
+		// Combine and multiply by the chirp filter
+		
+		for (i = 0; i < convSize; i++)
+		{
+			real = mZoomReal[i] - FFTData.imagp[i];
+			imag = mZoomImag[i] + FFTData.realp[i];
+			
+			mZoomReal[i] = (real * mZoomFilterReal[i]) - (imag * mZoomFilterImag[i]);
+			mZoomImag[i] = (real * mZoomFilterImag[i]) + (imag * mZoomFilterReal[i]);
+		}
+		
+		// The convolution is complex, so the real and imaginary parts are found from the symmetric parts of the spectrum (as two real inverse transforms)
+		// The spectrum for the real part is placed in the FFT data and the spectrum for the imaginary part replaces the product
+		
+		for (i = 0; i <= (convSize >> 1); i++)
+		{
+			unsigned long mirror = (convSize - i) & (convSize - 1);
+			
+			double lowReal = mZoomReal[i];
+			double lowImag = mZoomImag[i];
+			double highReal = mZoomReal[mirror];
+			double highImag = mZoomImag[mirror];
+			
+			FFTData.realp[i] = FFTData.realp[mirror] = 0.5 * (lowReal + highReal);
+			FFTData.imagp[i] = 0.5 * (lowImag - highImag);
+			FFTData.imagp[mirror] = -FFTData.imagp[i];
+			
+			mZoomReal[i] = mZoomReal[mirror] = 0.5 * (lowImag + highImag);
+			mZoomImag[i] = 0.5 * (highReal - lowReal);
+			mZoomImag[mirror] = -mZoomImag[i];
+		}
+		
+		if (spectrumToTime(gridReal, this) == FALSE)
+			return FALSE;
+		
+		for (i = 0; i < convSize; i++)
+		{
+			FFTData.realp[i] = mZoomReal[i];
+			FFTData.imagp[i] = mZoomImag[i];
+		}
+		
+		if (spectrumToTime(gridImag, this) == FALSE)
+			return FALSE;
+		
+		// Remove the output chirp to give the (unscaled) spectrum at each point of the grid
+		
+		for (i = 0; i < nGrid; i++)
+		{
+			real = gridReal[i];
+			imag = gridImag[i];
+			
+			gridReal[i] = (real * mZoomPostReal[i]) - (imag * mZoomPostImag[i]);
+			gridImag[i] = (real * mZoomPostImag[i]) + (imag * mZoomPostReal[i]);
+		}
+		
+		// Do tapers (as in calcPowerSpectrum() but with the pairs taken from the grid)
+		
+		double weightSum = kTapers - (((1.0 / (double) kTapers) - 3.0 + 2.0 * kTapers) / 6.0);
+		double normFactor = sqrt(2.) / (2 * mZoomFFTSize * weightSum);
+		
+		for (j = 0; j < mZoomBins; j++)
+			spectrum[j] = 0.;
+		
+		for (i = 1; i <= kTapers; i++)
+		{
+			double taperScale = (1.0 - ((i - 1) * (i - 1)) / (double) (kTapers * kTapers)) * scale * normFactor;
+			
+			for (j = 0; j < mZoomBins; j++)
+			{
+				unsigned long above = (j << 1) + kTapers + i;
+				unsigned long below = (j << 1) + kTapers - i;
+				
+				real = gridImag[above] - gridImag[below];
+				imag = gridReal[above] - gridReal[below];
+				
+				spectrum[j] += ((real * real) + (imag * imag)) * taperScale;
+			}
+		}
+		
+		return TRUE;
+	}
+
+
+private:
+
+	void freeZoom()
+	{
+		delete[] mZoomChirpReal;
+		delete[] mZoomChirpImag;
+		delete[] mZoomPostReal;
+		delete[] mZoomPostImag;
+		delete[] mZoomFilterReal;
+		delete[] mZoomFilterImag;
+		delete[] mZoomReal;
+		delete[] mZoomImag;
+		delete[] mZoomTemp;
+		
+		mZoomChirpReal = NULL;
+		mZoomChirpImag = NULL;
+		mZoomPostReal = NULL;
+		mZoomPostImag = NULL;
+		mZoomFilterReal = NULL;
+		mZoomFilterImag = NULL;
+		mZoomReal = NULL;
+		mZoomImag = NULL;
+		mZoomTemp = NULL;
+		
+		mZoomBins = 0;
+	}
+	
+	// DPSS Data
+	
+	double *mTaperedSamples;
+	double *mEigenSpectra;
+	
+	HISSTools_RefPtr<double> mDPSSTapers;
+	unsigned long mDPSSSamps;
+	double mDPSSNW;
+	unsigned long mDPSSK;
+	
+	// Zoom Data
+	
+	double *mZoomChirpReal;
+	double *mZoomChirpImag;
+	double *mZoomPostReal;
+	double *mZoomPostImag;
+	double *mZoomFilterReal;
+	double *mZoomFilterImag;
+	double *mZoomReal;
+	double *mZoomImag;
+	double *mZoomTemp;
+	
+	unsigned long mZoomSamps;
+	unsigned long mZoomFFTSize;
+	unsigned long mZoomConvSize;
+	unsigned long mZoomBins;
+	unsigned long mZoomTapers;
+	
+	unsigned long mMaxFFTSize;
 };
 
 #endif
\ No newline at end of file
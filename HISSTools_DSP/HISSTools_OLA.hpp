@@ -3,12 +3,29 @@
 #ifndef __HISSTOOLS_OLA__
 #define __HISSTOOLS_OLA__
 
+#include <cassert>
 
-class HISSTools_OLA {
+#include "../HISSTools_Utility/HISSTools_ThreadSafety.hpp"
+#include "../HISSTools_Utility/HISSTools_Scheduler.hpp"
+#include "../HISSTools_Utility/HISSTools_State.hpp"
+
+
+// Statically dispatched engine (CRTP)
+//
+// Derive as class MyOLA : public HISSTools_OLA_Base <MyOLA> so that process() is resolved (and can be inlined) at compile time
+// Declare the process() overloads you need with the same signatures as below (non-virtual) and make them accessible to the base
+// If only some overloads are declared add using HISSTools_OLA_Base <MyOLA>::process; so that the defaults remain visible
+//
+// N.B. when pipelined a frame may still be processing on a worker thread after overlapAdd() returns
+// Any class that enables pipelining must call stopPipeline() at the start of its own destructor (before its members are destroyed)
+// The base destructor cannot do this safely, as process() would be called on a partly destroyed object (debug builds assert this)
+
+template <class Derived>
+class HISSTools_OLA_Base {
 	
 public:
 	
-	HISSTools_OLA(unsigned long maxFrameSize, unsigned long maxChans)
+	HISSTools_OLA_Base(unsigned long maxFrameSize, unsigned long maxChans)
 	{		
 		bool success = TRUE;
 		
@@ -33,12 +50,56 @@ public:
 		
 		mMaxFrameSize = (success == TRUE) ? maxFrameSize : 0;
 	
+		// Parameters
+		
+		mFrameSize = 0;
+		mHopSize = 0;
+		mBlockIOPointer = 0;
+		mBlockHopPointer = 0;
+		mStreamTime = 0;
+		mNParams = 0;
+		mNPendingEvents = 0;
+		mFrameEnd = 0;
+		mFrameCount = 0;
+		mEngine = NULL;
+		mNewEngine = NULL;
+		mFixedEngines = TRUE;
+		
+		// Pipelining (off by default)
+		
+		mClient = NULL;
+		mSlotWrite = 0;
+		mPipelineStalls = 0;
+		mHopDuration = 0.0;
+		
+		for (unsigned long i = 0; i < kPipelineSlots; i++)
+		{
+			mSlots[i].mOwner = this;
+			
+			for (unsigned long j = 0; j < mMaxChans; j++)
+				mSlots[i].mFrames[j] = NULL;
+		}
+		
+		for (unsigned long i = 0; i < kMaxParams; i++)
+		{
+			mParamStates[i] = ParamState(0.0);
+			mParamValues[i] = 0.0;
+			mParamRamps[i] = NULL;
+			mParamRampFrames[i] = 0;
+		}
+		
 		setParams(maxFrameSize, maxFrameSize / 2, TRUE);
 	}
 		
 	
-	~HISSTools_OLA()
+	~HISSTools_OLA_Base()
 	{		
+		// Pipelining must have been stopped by the derived class (this only stops it as a last resort)
+		
+		assert(!mClient && "HISSTools_OLA_Base: call stopPipeline() in the destructor of any class that is pipelined");
+		
+		stopPipeline();
+		
 		// Delete individual channel pointers
 
 		for (unsigned long i = 0; i < mMaxChans; i++) 
@@ -47,6 +108,9 @@ public:
 			delete[] mOutputBuffers[i];
 			delete[] mFrameBuffers[i];
 		}
+		
+		for (unsigned long i = 0; i < kMaxParams; i++)
+			delete[] mParamRamps[i];
 	}
 	
 	
@@ -103,8 +167,9 @@ private:
         
 		if (mReset == TRUE || mNewFrameSize != mFrameSize || mNewHopSize != mHopSize)
 		{	
-			// Reset
+			// Reset (discarding any frame in the pipeline)
 			
+			flushPipeline();
 			reset(mNewFrameSize);
 			
 			// Update parameters
@@ -113,11 +178,118 @@ private:
 			mHopSize = mNewHopSize;
 			mBlockIOPointer = 0;
 			mBlockHopPointer = mNewHopOffset;
+			mEngine = mNewEngine;
 			mReset = FALSE;
 		}
 	}
 	
 	
+	// Parameter Events
+	
+	struct ParamEvent
+	{
+		unsigned long mIndex;
+		unsigned long mRampTime;
+		unsigned long long mTime;
+		double mValue;
+	};
+	
+	struct ParamState
+	{
+		ParamState() {}
+		ParamState(double value) : mStart(value), mTarget(value), mStartTime(0), mEndTime(0) {}
+		
+		double valueAt(double time) const
+		{
+			if (time >= mEndTime)
+				return mTarget;
+			if (time <= mStartTime)
+				return mStart;
+			
+			return mStart + (mTarget - mStart) * ((time - mStartTime) / (double) (mEndTime - mStartTime));
+		}
+		
+		void apply(const ParamEvent& event)
+		{
+			// Ramps start from the value at the time of the event
+			
+			mStart = valueAt((double) event.mTime);
+			mTarget = event.mValue;
+			mStartTime = event.mTime;
+			mEndTime = event.mTime + event.mRampTime;
+		}
+		
+		double mStart;
+		double mTarget;
+		unsigned long long mStartTime;
+		unsigned long long mEndTime;
+	};
+	
+	
+	void drainParams()
+	{
+		// Move queued events into the (time ordered) pending list, converting block offsets to stream time
+		
+		ParamEvent event;
+		
+		while (mParamQueue.pop(event))
+		{
+			event.mTime += mStreamTime;
+			
+			// If the pending list is full the oldest event is applied early
+			
+			if (mNPendingEvents == kMaxPendingEvents)
+			{
+				mParamStates[mPendingEvents[0].mIndex].apply(mPendingEvents[0]);
+				removePendingEvents(1);
+			}
+			
+			unsigned long i = mNPendingEvents++;
+			
+			for (; i && mPendingEvents[i - 1].mTime > event.mTime; i--)
+				mPendingEvents[i] = mPendingEvents[i - 1];
+			
+			mPendingEvents[i] = event;
+		}
+	}
+	
+	
+	void removePendingEvents(unsigned long nEvents)
+	{
+		mNPendingEvents -= nEvents;
+		
+		for (unsigned long i = 0; i < mNPendingEvents; i++)
+			mPendingEvents[i] = mPendingEvents[i + nEvents];
+	}
+	
+	
+	void updateParams(unsigned long long frameEnd, unsigned long frameSize)
+	{
+		// The states are advanced to the start of the frame and the values calculated at the frame centre
+		
+		unsigned long long frameStart = frameEnd > frameSize ? frameEnd - frameSize : 0;
+		double frameCentre = frameEnd - frameSize * 0.5;
+		unsigned long i;
+		
+		for (i = 0; i < mNPendingEvents && mPendingEvents[i].mTime <= frameStart; i++)
+			mParamStates[mPendingEvents[i].mIndex].apply(mPendingEvents[i]);
+		
+		removePendingEvents(i);
+		
+		for (i = 0; i < mNParams; i++)
+			mParamScratch[i] = mParamStates[i];
+		
+		for (i = 0; i < mNPendingEvents && mPendingEvents[i].mTime <= frameCentre; i++)
+			mParamScratch[mPendingEvents[i].mIndex].apply(mPendingEvents[i]);
+		
+		for (i = 0; i < mNParams; i++)
+			mParamValues[i] = mParamScratch[i].valueAt(frameCentre);
+		
+		mFrameEnd = frameEnd;
+		mFrameCount++;
+	}
+	
+	
 	long loopMin(long hopTime, long writeTime, long blockTime)
 	{
 		long minTime = hopTime;
@@ -131,22 +303,346 @@ private:
 	}
 	
 	
+	Derived *derived()
+	{
+		return static_cast<Derived *>(this);
+	}
+	
+	
+	// Pipelining
+	
+	// Frames are copied to a slot and processed by the shared scheduler, and the result is overlap-added one hop later
+	// Each frame is due by the next hop, so the workers have a full hop to process it (the audio thread only waits if they are late)
+	
+	void pipelineFrame(long IOPointer, unsigned long frameSize, unsigned long hopSize, unsigned long nChans, bool singleChannel)
+	{
+		PipelineSlot &slot = mSlots[mSlotWrite];
+		PipelineSlot &previous = mSlots[(mSlotWrite + kPipelineSlots - 1) % kPipelineSlots];
+		
+		// Wait for the previous frame before queueing the current one (so frames of one instance never run concurrently or out of order)
+		
+		if (previous.isQueued())
+		{
+			mPipelineStalls++;
+			previous.wait();
+		}
+		
+		// Queue the current frame (processing it immediately if the scheduler is full)
+		
+		for (unsigned long j = 0; j < nChans; j++)
+			for (unsigned long k = 0; k < frameSize; k++)
+				slot.mFrames[j][k] = mInputBuffers[j][IOPointer + k];
+		
+		for (unsigned long j = 0; j < mNParams; j++)
+			slot.mParams[j] = mParamValues[j];
+		
+		slot.mFrameSize = frameSize;
+		slot.mNChans = nChans;
+		slot.mSingleChannel = singleChannel;
+		
+		if (HISSTools_Scheduler::get().submit(mClient, &slot, mHopDuration * hopSize) == FALSE)
+			slot.runNow();
+		
+		// Overlap-add the previous frame (at the current position, so that the output is delayed by one hop)
+		
+		for (unsigned long j = 0; j < nChans; j++)
+		{
+			if (previous.isDone())
+				writeFrameChannel(mOutputBuffers[j], previous.mFrames[j], IOPointer, frameSize, hopSize);
+			else
+			{
+				// There is no previous frame after a reset so the non-overlapping part is cleared
+				
+				for (unsigned long k = frameSize - hopSize; k < frameSize; k++)
+					mOutputBuffers[j][(IOPointer + k) % frameSize] = 0.0;
+			}
+		}
+		
+		previous.clear();
+		mSlotWrite = (mSlotWrite + 1) % kPipelineSlots;
+	}
+	
+	
+	void flushPipeline()
+	{
+		// Wait for any queued frames and discard the results
+		
+		if (!mClient)
+			return;
+		
+		for (unsigned long i = 0; i < kPipelineSlots; i++)
+			mSlots[i].clear();
+	}
+	
+	
+	void runSlot(double **frames, unsigned long frameSize, unsigned long nChans, bool singleChannel, const double *params)
+	{
+		if (singleChannel == TRUE)
+			derived()->process(frames[0], frameSize, params);
+		else
+			derived()->process(frames, frameSize, nChans, params);
+	}
+	
+	
+	// State
+	
+	void writeState(HISSTools_StateWriter& writer, unsigned long nPendingEvents, bool previousDone)
+	{
+		// Write the state with the given number of pending events (storing the previous frame if it is done)
+		
+		PipelineSlot &previous = mSlots[(mSlotWrite + kPipelineSlots - 1) % kPipelineSlots];
+		unsigned long position = writer.beginState(kStateTagOLA, kStateVersion);
+		bool pipelined = mClient != NULL;
+		
+		writer.write(mMaxFrameSize);
+		writer.write(mMaxChans);
+		writer.write(mNParams);
+		writer.write(pipelined);
+		
+		writer.write(mFrameSize);
+		writer.write(mHopSize);
+		writer.write(mNewFrameSize);
+		writer.write(mNewHopSize);
+		writer.write(mNewHopOffset);
+		writer.write(mReset);
+		writer.write(mBlockIOPointer);
+		writer.write(mBlockHopPointer);
+		writer.write(mStreamTime);
+		writer.write(mFrameEnd);
+		writer.write(mFrameCount);
+		writer.write(nPendingEvents);
+		writer.write(previousDone);
+		
+		writer.write(mParamStates, mNParams);
+		writer.write(mParamValues, mNParams);
+		writer.write(mPendingEvents, nPendingEvents);
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+		{
+			writer.write(mInputBuffers[i], mFrameSize * 2);
+			writer.write(mOutputBuffers[i], mFrameSize);
+			
+			if (previousDone == TRUE)
+				writer.write(previous.mFrames[i], mFrameSize);
+		}
+		
+		writer.endState(position);
+	}
+	
+	
+	// Fixed Size Engines
+	
+	// Specialised versions of overlapAdd() for power of two frame sizes with an overlap of 2 or 4
+	// N.B. at an overlap of 8 the specialised versions measured slower than the generic code, so they are not selected
+	// Wrapping uses a mask, so the IO pointer never leaves the buffer and the only loop test is the hop / block end
+	
+	typedef bool (HISSTools_OLA_Base::*Engine)(double **ins, double **outs, unsigned long nSamps, unsigned long nChans, bool singleChannel);
+	
+	template <unsigned long FrameSize, unsigned long Overlap>
+	bool overlapAddFixed(double **ins, double **outs, unsigned long nSamps, unsigned long nChans, bool singleChannel)
+	{
+		const unsigned long hopSize = FrameSize / Overlap;
+		const unsigned long mask = FrameSize - 1;
+		
+		bool processedFrames = FALSE;
+		
+		unsigned long IOPointer = mBlockIOPointer & mask;
+		unsigned long hopPointer = mBlockHopPointer;
+		unsigned long loopSize;
+		
+		for (unsigned long i = 0; i < nSamps;)
+		{
+			// Grab a frame and OLA with processing
+			
+			if (hopPointer >= hopSize)
+			{
+				processedFrames = TRUE;
+				hopPointer = 0;
+				
+				for (unsigned long j = 0; j < nChans; j++)
+				{
+					double *inputBuffer = mInputBuffers[j] + IOPointer;
+					double *frameBuffer = mFrameBuffers[j];
+					
+					for (unsigned long k = 0; k < FrameSize; k++)
+						frameBuffer[k] = inputBuffer[k];
+				}
+				
+				updateParams(mStreamTime + i, FrameSize);
+				
+				if (singleChannel == TRUE)
+					derived()->process(mFrameBuffers[0], FrameSize, mParamValues);
+				else
+					derived()->process(mFrameBuffers, FrameSize, nChans, mParamValues);
+				
+				// Write hop by hop (the last hop is non-overlapping) - only a hop crossing the buffer end needs masking
+				
+				for (unsigned long j = 0; j < nChans; j++)
+				{
+					for (unsigned long k = 0; k < Overlap; k++)
+					{
+						double *frameBuffer = mFrameBuffers[j] + k * hopSize;
+						double *outputBuffer = mOutputBuffers[j];
+						unsigned long offset = (IOPointer + k * hopSize) & mask;
+						
+						if (offset + hopSize <= FrameSize)
+						{
+							outputBuffer += offset;
+							
+							if (k < Overlap - 1)
+								for (unsigned long l = 0; l < hopSize; l++)
+									outputBuffer[l] += frameBuffer[l];
+							else
+								for (unsigned long l = 0; l < hopSize; l++)
+									outputBuffer[l] = frameBuffer[l];
+						}
+						else
+						{
+							if (k < Overlap - 1)
+								for (unsigned long l = 0; l < hopSize; l++)
+									outputBuffer[(offset + l) & mask] += frameBuffer[l];
+							else
+								for (unsigned long l = 0; l < hopSize; l++)
+									outputBuffer[(offset + l) & mask] = frameBuffer[l];
+						}
+					}
+				}
+			}
+			
+			// Check loop size (the end of the buffer is handled by masking)
+			
+			loopSize = hopSize - hopPointer < nSamps - i ? hopSize - hopPointer : nSamps - i;
+			
+			// Loop over channels and copy samples in/out
+			
+			for (unsigned long j = 0; j < nChans; j++)
+			{
+				double *inputBuffer = mInputBuffers[j];
+				double *outputBuffer = mOutputBuffers[j];
+				double *in = ins[j] + i;
+				double *out = outs[j] + i;
+				
+				if (IOPointer + loopSize <= FrameSize)
+				{
+					for (unsigned long k = 0, l = IOPointer; k < loopSize; k++, l++)
+					{
+						inputBuffer[l] = inputBuffer[l + FrameSize] = in[k];
+						out[k] = outputBuffer[l];
+					}
+				}
+				else
+				{
+					for (unsigned long k = 0, l = IOPointer; k < loopSize; k++, l = (l + 1) & mask)
+					{
+						inputBuffer[l] = inputBuffer[l + FrameSize] = in[k];
+						out[k] = outputBuffer[l];
+					}
+				}
+			}
+			
+			IOPointer = (IOPointer + loopSize) & mask;
+			hopPointer += loopSize;
+			i += loopSize;
+		}
+		
+		mBlockIOPointer = IOPointer;
+		mBlockHopPointer = hopPointer;
+		mStreamTime += nSamps;
+		
+		return processedFrames;
+	}
+	
+	
+	template <unsigned long FrameSize>
+	static Engine getEngine(unsigned long hopSize)
+	{
+		if (hopSize * 2 == FrameSize)
+			return &HISSTools_OLA_Base::overlapAddFixed<FrameSize, 2>;
+		if (hopSize * 4 == FrameSize)
+			return &HISSTools_OLA_Base::overlapAddFixed<FrameSize, 4>;
+		
+		return NULL;
+	}
+	
+	
+	static Engine getEngine(unsigned long frameSize, unsigned long hopSize)
+	{
+		// Returns NULL for sizes without a specialised engine (the generic code is used instead)
+		
+		switch (frameSize)
+		{
+			case 256:		return getEngine<256>(hopSize);
+			case 512:		return getEngine<512>(hopSize);
+			case 1024:		return getEngine<1024>(hopSize);
+			case 2048:		return getEngine<2048>(hopSize);
+			case 4096:		return getEngine<4096>(hopSize);
+			case 8192:		return getEngine<8192>(hopSize);
+		}
+		
+		return NULL;
+	}
+
+
 protected:
 	
-	void virtual process(double *ioFrame, unsigned long frameSize)
+	// Default processing (hidden by the derived class declarations - calls are dispatched to the derived class)
+	
+	void process(double *ioFrame, unsigned long frameSize)
 	{
-		// This function should be overridden for single channel operation. 
-		// IO is on a single shared buffer
 	}
 	
 	
-	void virtual process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
 	{
-		// This function should be overridden for multichannel operation. 
-		// IO is on a single shared buffer per channel
 	}
 	
 	
+	void process(double *ioFrame, unsigned long frameSize, const double *params)
+	{
+		derived()->process(ioFrame, frameSize);
+	}
+	
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans, const double *params)
+	{
+		derived()->process(ioFrames, frameSize, nChans);
+	}
+	
+	
+	const double *getParamRamp(unsigned long index)
+	{
+		// Sample-accurate values of a parameter for each sample of the current frame (call from process)
+		// Each ramp is calculated at most once per frame, so it can be shared between channels / bins
+		
+		// N.B. ramps are not available when pipelined (the parameter state belongs to the audio thread)
+		
+		if (index >= mNParams || !mParamRamps[index] || mClient)
+			return NULL;
+		
+		if (mParamRampFrames[index] != mFrameCount)
+		{
+			ParamState state = mParamStates[index];
+			double *ramp = mParamRamps[index];
+			unsigned long frameSize = mFrameSize;
+			long long time = (long long) mFrameEnd - (long long) frameSize;
+			unsigned long i, j;
+			
+			for (i = 0, j = 0; i < frameSize; i++, time++)
+			{
+				for (; j < mNPendingEvents && (long long) mPendingEvents[j].mTime <= time; j++)
+					if (mPendingEvents[j].mIndex == index)
+						state.apply(mPendingEvents[j]);
+				
+				ramp[i] = state.valueAt((double) time);
+			}
+			
+			mParamRampFrames[index] = mFrameCount;
+		}
+		
+		return mParamRamps[index];
+	}
+
+
 public:
 	
 	bool overlapAdd(double *in, double *out, unsigned long nSamps)
@@ -167,6 +663,12 @@ public:
 		// Update parameters
 		
 		update();
+		drainParams();
+		
+		// Use a specialised engine if there is one for the current sizes
+		
+		if (mEngine && mFixedEngines && !mClient)
+			return (this->*mEngine)(&in, &out, nSamps, 1UL, TRUE);
 		
 		// Get parameters
 		
@@ -186,11 +688,18 @@ public:
                 processedFrames = TRUE;
                 hopPointer = 0;
                 
-				for (long j = 0; j < frameSize; j++)
-					frameBuffer[j] = inputBuffer[IOPointer + j];
+				updateParams(mStreamTime + i, frameSize);
 
-				process(frameBuffer, frameSize);
-				writeFrameChannel(outputBuffer, frameBuffer, IOPointer, frameSize, hopSize);
+				if (mClient)
+					pipelineFrame(IOPointer, frameSize, hopSize, 1UL, TRUE);
+				else
+				{
+					for (long j = 0; j < frameSize; j++)
+						frameBuffer[j] = inputBuffer[IOPointer + j];
+					
+					derived()->process(frameBuffer, frameSize, mParamValues);
+					writeFrameChannel(outputBuffer, frameBuffer, IOPointer, frameSize, hopSize);
+				}
 			}
 			
 			// Update pointers and check loop size
@@ -212,6 +721,7 @@ public:
 		
 		mBlockIOPointer = IOPointer;
 		mBlockHopPointer = hopPointer;
+		mStreamTime += nSamps;
         
         return processedFrames;
 	}
@@ -236,6 +746,12 @@ public:
 		// Update parameters
 		
 		update();
+		drainParams();
+		
+		// Use a specialised engine if there is one for the current sizes
+		
+		if (mEngine && mFixedEngines && !mClient)
+			return (this->*mEngine)(ins, outs, nSamps, nChans, FALSE);
 		
 		// Get parameters
 		
@@ -255,14 +771,21 @@ public:
                 processedFrames = TRUE;
                 hopPointer = 0;
                 
-				for (long j = 0; j < nChans; j++)
-					for (long k = 0; k < frameSize; k++)
-						mFrameBuffers[j][k] = mInputBuffers[j][IOPointer + k];
+				updateParams(mStreamTime + i, frameSize);
 				
-				process(mFrameBuffers, frameSize, nChans);
+				if (mClient)
+					pipelineFrame(IOPointer, frameSize, hopSize, nChans, FALSE);
+				else
+				{
+					for (long j = 0; j < nChans; j++)
+						for (long k = 0; k < frameSize; k++)
+							mFrameBuffers[j][k] = mInputBuffers[j][IOPointer + k];
 				
-				for (long j = 0; j < nChans; j++)					
-					writeFrameChannel(mOutputBuffers[j], mFrameBuffers[j], IOPointer, frameSize, hopSize);
+					derived()->process(mFrameBuffers, frameSize, nChans, mParamValues);
+					
+					for (long j = 0; j < nChans; j++)					
+						writeFrameChannel(mOutputBuffers[j], mFrameBuffers[j], IOPointer, frameSize, hopSize);
+				}
 			}
 			
 			// Update pointers and check loop size
@@ -288,6 +811,7 @@ public:
 		
 		mBlockIOPointer = IOPointer;
 		mBlockHopPointer = hopPointer;
+		mStreamTime += nSamps;
 		
 		return processedFrames;
 	}
@@ -298,10 +822,287 @@ public:
 		mNewFrameSize = frameSize < mMaxFrameSize ? (frameSize ? frameSize : 1) : mMaxFrameSize;
 		mNewHopSize = hopSize <= mNewFrameSize ? (hopSize ? hopSize : 1) : mNewFrameSize;
 		mNewHopOffset = hopOffset > mNewHopSize ? mNewHopSize : hopOffset;
+		mNewEngine = getEngine(mNewFrameSize, mNewHopSize);
 		mReset = reset;
 	}
 	
 	
+	void setNumParams(unsigned long nParams, bool ramps = FALSE)
+	{
+		// N.B. this allocates memory and is not threadsafe
+		
+		mNParams = nParams < kMaxParams ? nParams : kMaxParams;
+		
+		for (unsigned long i = 0; i < kMaxParams; i++)
+		{
+			delete[] mParamRamps[i];
+			mParamRamps[i] = (ramps == TRUE && i < mNParams) ? new double[mMaxFrameSize] : NULL;
+			mParamRampFrames[i] = 0;
+		}
+	}
+	
+	
+	bool pushParam(unsigned long index, double value, unsigned long offset = 0, unsigned long rampTime = 0)
+	{
+		// Queue a change that ramps to value over rampTime samples, starting offset samples into the next call to overlapAdd()
+		// This may be called from any thread (values reach process() at the frame centres, without races)
+		
+		ParamEvent event;
+		
+		if (index >= mNParams)
+			return FALSE;
+		
+		event.mIndex = index;
+		event.mValue = value;
+		event.mTime = offset;
+		event.mRampTime = rampTime;
+		
+		mParamPushLock.acquire();
+		bool success = mParamQueue.push(event);
+		mParamPushLock.release();
+		
+		return success;
+	}
+	
+	
+	unsigned long getFrameSize()
+	{
+		return mFrameSize;
+	}
+	
+	
+	unsigned long getHopSize()
+	{
+		return mHopSize;
+	}
+	
+	
+	double getParam(unsigned long index)
+	{
+		// Value at the centre of the most recent frame
+		
+		return index < mNParams ? mParamValues[index] : 0.0;
+	}
+	
+	
+	void setPipelined(bool pipelined, double samplingRate = 44100.0)
+	{
+		// When pipelined process() is called on a worker thread of HISSTools_Scheduler and the output is delayed by an extra hop
+		// The sampling rate sets the deadlines (one hop after each frame is taken)
+		// N.B. this registers with the scheduler, allocates memory and is not threadsafe (the stream is reset)
+		// N.B. a frame may be processing after overlapAdd() returns - see stopPipeline()
+		// N.B. a pipelined class must call stopPipeline() (or setPipelined(FALSE)) at the start of its own destructor
+		
+		mHopDuration = samplingRate > 0.0 ? 1.0 / samplingRate : 1.0 / 44100.0;
+		
+		if (pipelined == (mClient != NULL))
+			return;
+		
+		if (pipelined == TRUE)
+		{
+			if (!(mClient = HISSTools_Scheduler::get().registerClient()))
+				return;
+			
+			for (unsigned long i = 0; i < kPipelineSlots; i++)
+				for (unsigned long j = 0; j < mMaxChans; j++)
+					mSlots[i].mFrames[j] = new double[mMaxFrameSize];
+		}
+		else
+		{
+			flushPipeline();
+			HISSTools_Scheduler::get().unregisterClient(mClient);
+			mClient = NULL;
+			
+			for (unsigned long i = 0; i < kPipelineSlots; i++)
+			{
+				for (unsigned long j = 0; j < mMaxChans; j++)
+				{
+					delete[] mSlots[i].mFrames[j];
+					mSlots[i].mFrames[j] = NULL;
+				}
+			}
+		}
+		
+		mReset = TRUE;
+	}
+	
+	
+	void setFixedEngines(bool fixedEngines)
+	{
+		// The fixed size engines are used where available unless this is turned off (for comparison with the generic engine)
+		// Both engines share the stream state, so this may be changed between calls to overlapAdd()
+		
+		mFixedEngines = fixedEngines;
+	}
+	
+	
+	void stopPipeline()
+	{
+		// Wait for any frame in progress and stop pipelining (this must be called at the start of the destructor of a pipelined class)
+		
+		setPipelined(FALSE);
+	}
+	
+	
+	unsigned long getLatency()
+	{
+		// Input to output delay in samples (a frame, plus a hop when pipelined) for the most recently set parameters
+		
+		return mNewFrameSize + (mClient ? mNewHopSize : 0);
+	}
+	
+	
+	HISSTools_Scheduler::Client *getSchedulerClient()
+	{
+		// For setting a budget and reading timing statistics (NULL when not pipelined)
+		
+		return mClient;
+	}
+	
+	
+	unsigned long long getPipelineStalls()
+	{
+		// Number of hops for which the audio thread had to wait for the scheduler
+		
+		return mPipelineStalls;
+	}
+
+
+	// State
+	
+	// N.B. call these from the audio thread (or when not processing) - saving moves queued parameter changes into the state
+	// The size allows for a full list of pending events and a stored frame (so it has no side effects - the state saved may be smaller)
+	
+	unsigned long getStateSize()
+	{
+		HISSTools_StateWriter writer;
+		writeState(writer, kMaxPendingEvents, mClient != NULL);
+		return writer.getPosition();
+	}
+	
+	
+	bool saveState(void *data, unsigned long size)
+	{
+		HISSTools_StateWriter writer(data, size);
+		writeState(writer);
+		return writer.isValid();
+	}
+	
+	
+	bool restoreState(const void *data, unsigned long size)
+	{
+		HISSTools_StateReader reader(data, size);
+		return readState(reader);
+	}
+	
+	
+	void writeState(HISSTools_StateWriter& writer)
+	{
+		// When pipelined the frame in progress is waited for and its result stored (so no frame is lost)
+		
+		PipelineSlot &previous = mSlots[(mSlotWrite + kPipelineSlots - 1) % kPipelineSlots];
+		bool previousDone = FALSE;
+		
+		drainParams();
+		
+		if (mClient)
+		{
+			previous.wait();
+			previousDone = previous.isDone();
+		}
+		
+		writeState(writer, mNPendingEvents, previousDone);
+	}
+	
+	
+	bool readState(HISSTools_StateReader& reader)
+	{
+		// The maximums, number of parameters and pipelining must match (nothing is restored otherwise)
+		// Parameter changes queued since the state was saved are discarded
+		
+		unsigned long frameSize = 0, hopSize = 0, newFrameSize = 0, newHopSize = 0, newHopOffset = 0, nPendingEvents = 0;
+		unsigned long long streamTime = 0, frameEnd = 0, frameCount = 0;
+		long blockIOPointer = 0, blockHopPointer = 0;
+		bool reset = TRUE, previousDone = FALSE;
+		
+		ParamEvent event;
+		
+		if (reader.beginState(kStateTagOLA, kStateVersion) == FALSE)
+			return FALSE;
+		if (reader.check(mMaxFrameSize) == FALSE || reader.check(mMaxChans) == FALSE || reader.check(mNParams) == FALSE || reader.check(mClient != NULL) == FALSE)
+			return FALSE;
+		
+		reader.read(frameSize);
+		reader.read(hopSize);
+		reader.read(newFrameSize);
+		reader.read(newHopSize);
+		reader.read(newHopOffset);
+		reader.read(reset);
+		reader.read(blockIOPointer);
+		reader.read(blockHopPointer);
+		reader.read(streamTime);
+		reader.read(frameEnd);
+		reader.read(frameCount);
+		reader.read(nPendingEvents);
+		reader.read(previousDone);
+		
+		if (reader.isValid() == FALSE || frameSize > mMaxFrameSize || hopSize > frameSize || newFrameSize > mMaxFrameSize || newHopSize > newFrameSize || newHopOffset > newHopSize)
+			return FALSE;
+		if (blockIOPointer < 0 || blockHopPointer < 0 || blockHopPointer > (long) hopSize || nPendingEvents > kMaxPendingEvents || (previousDone == TRUE && !mClient))
+			return FALSE;
+		if (reader.canRead(mNParams * (sizeof(ParamState) + sizeof(double)) + nPendingEvents * sizeof(ParamEvent) + mMaxChans * frameSize * (previousDone == TRUE ? 4 : 3) * sizeof(double)) == FALSE)
+			return FALSE;
+		
+		// Discard any frames in the pipeline and any queued parameter changes
+		
+		flushPipeline();
+		
+		while (mParamQueue.pop(event));
+		
+		// Restore
+		
+		mFrameSize = frameSize;
+		mHopSize = hopSize;
+		mNewFrameSize = newFrameSize;
+		mNewHopSize = newHopSize;
+		mNewHopOffset = newHopOffset;
+		mReset = reset;
+		mBlockIOPointer = blockIOPointer;
+		mBlockHopPointer = blockHopPointer;
+		mStreamTime = streamTime;
+		mFrameEnd = frameEnd;
+		mFrameCount = frameCount;
+		mNPendingEvents = nPendingEvents;
+		mEngine = getEngine(mFrameSize, mHopSize);
+		mNewEngine = getEngine(mNewFrameSize, mNewHopSize);
+		
+		reader.read(mParamStates, mNParams);
+		reader.read(mParamValues, mNParams);
+		reader.read(mPendingEvents, mNPendingEvents);
+		
+		for (unsigned long i = 0; i < kMaxParams; i++)
+			mParamRampFrames[i] = mFrameCount - 1;
+		
+		// The stored result is overlap-added at the next hop (from the slot before the next one written)
+		
+		mSlotWrite = 0;
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+		{
+			reader.read(mInputBuffers[i], mFrameSize * 2);
+			reader.read(mOutputBuffers[i], mFrameSize);
+			
+			if (previousDone == TRUE)
+				reader.read(mSlots[kPipelineSlots - 1].mFrames[i], mFrameSize);
+		}
+		
+		if (previousDone == TRUE)
+			mSlots[kPipelineSlots - 1].complete();
+		
+		return reader.isValid();
+	}
+
+
 private:
 	
 	// Data
@@ -331,9 +1132,122 @@ private:
 	unsigned long mNewHopSize;
 	unsigned long mNewHopOffset;
 	
+	// Engines (NULL for the generic engine)
+	
+	Engine mEngine;
+	Engine mNewEngine;
+	bool mFixedEngines;
+	
+	// Parameters
+	
+	static const unsigned long kMaxParams = 64;
+	static const unsigned long kMaxPendingEvents = 256;
+	
+	HISSTools_LockFreeQueue <ParamEvent, 1024> mParamQueue;
+	HISSTools_SpinLock mParamPushLock;
+	
+	ParamEvent mPendingEvents[kMaxPendingEvents];
+	unsigned long mNPendingEvents;
+	
+	ParamState mParamStates[kMaxParams];
+	ParamState mParamScratch[kMaxParams];
+	double mParamValues[kMaxParams];
+	double *mParamRamps[kMaxParams];
+	unsigned long long mParamRampFrames[kMaxParams];
+	unsigned long mNParams;
+	
+	unsigned long long mStreamTime;
+	unsigned long long mFrameEnd;
+	unsigned long long mFrameCount;
+	
+	// Pipelining
+	
+	static const unsigned long kPipelineSlots = 2;
+	
+	struct PipelineSlot : public HISSTools_Scheduler::Job
+	{
+		void run()
+		{
+			mOwner->runSlot(mFrames, mFrameSize, mNChans, mSingleChannel, mParams);
+		}
+		
+		HISSTools_OLA_Base *mOwner;
+		double *mFrames[256];
+		double mParams[kMaxParams];
+		unsigned long mFrameSize;
+		unsigned long mNChans;
+		bool mSingleChannel;
+	};
+	
+	PipelineSlot mSlots[kPipelineSlots];
+	unsigned long mSlotWrite;
+	unsigned long long mPipelineStalls;
+	double mHopDuration;
+	
+	HISSTools_Scheduler::Client *mClient;
+	
 	// Reset
 	
 	bool mReset;
+	
+	// State Version
+	
+	static const uint32_t kStateVersion = 1;
+};
+
+
+// Virtual processing interface
+//
+// Derive from this class and override the process() overloads (as before) - each frame costs a virtual call
+// N.B. if pipelining is used call stopPipeline() at the start of the destructor of the derived class (see HISSTools_OLA_Base)
+
+class HISSTools_OLA : public HISSTools_OLA_Base <HISSTools_OLA>
+{
+	friend class HISSTools_OLA_Base <HISSTools_OLA>;
+
+public:
+
+	HISSTools_OLA(unsigned long maxFrameSize, unsigned long maxChans) : HISSTools_OLA_Base <HISSTools_OLA> (maxFrameSize, maxChans)
+	{
+	}
+	
+	virtual ~HISSTools_OLA()
+	{
+	}
+
+
+protected:
+
+	void virtual process(double *ioFrame, unsigned long frameSize)
+	{
+		// This function should be overridden for single channel operation. 
+		// IO is on a single shared buffer
+	}
+	
+	
+	void virtual process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		// This function should be overridden for multichannel operation. 
+		// IO is on a single shared buffer per channel
+	}
+	
+	
+	void virtual process(double *ioFrame, unsigned long frameSize, const double *params)
+	{
+		// This function should be overridden for single channel operation (where you wish to receive parameter values).
+		// Parameter values are interpolated at the frame centre
+		
+		process(ioFrame, frameSize);
+	}
+	
+	
+	void virtual process(double **ioFrames, unsigned long frameSize, unsigned long nChans, const double *params)
+	{
+		// This function should be overridden for multichannel operation (where you wish to receive parameter values).
+		// Parameter values are interpolated at the frame centre
+		
+		process(ioFrames, frameSize, nChans);
+	}
 };
 
 
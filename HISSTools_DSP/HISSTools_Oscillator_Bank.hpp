@@ -0,0 +1,448 @@
+
+
+#ifndef __HISSTOOLS_OSCILLATOR_BANK__
+#define __HISSTOOLS_OSCILLATOR_BANK__
+
+
+#include <algorithm>
+#include <cmath>
+#include "HISSTools_Spectral_Peaks.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HISSTOOLS_OSCILLATOR_BANK_SSE2
+#endif
+
+
+// Additive resynthesis of spectral peaks with a bank of recursive (complex rotation) oscillators
+//
+// Each frame of peaks is matched to the current partials by frequency (peaks must be in ascending order of frequency, as from findPeaks())
+// Matched partials glide to the new frequency and amplitude, unmatched peaks are born at zero amplitude and unmatched partials fade out
+//
+// Frequency and amplitude are interpolated linearly per sample over the ramp given with each frame, with the phase running continuously
+// Each oscillator multiplies its phase by a rotor, and whilst the frequency is ramping the rotor is itself multiplied by a fixed step
+// The phases are renormalised per block, and the rotors are reset exactly at the end of each ramp, so no error accumulates
+//
+// Frequencies are normalised (bin / FFTSize) as for peakFreq - amplitudes are used directly (pass fromPower as TRUE for power spectra)
+
+
+class HISSTools_Oscillator_Bank
+{
+
+private:
+
+	static const unsigned long kBlockSize = 256;
+	
+	// State for each partial (stored as separate arrays for vectorisation)
+	
+	struct Partials {
+	
+		double *phaseReal;
+		double *phaseImag;
+		double *rotorReal;
+		double *rotorImag;
+		double *stepReal;
+		double *stepImag;
+		double *amp;
+		double *ampStep;
+		double *freq;
+		double *targetAmp;
+	
+	};
+
+
+public:
+
+	HISSTools_Oscillator_Bank(unsigned long maxPartials)
+	{
+		mMaxPartials = maxPartials;
+		mNPartials = 0;
+		mRampRemaining = 0;
+		mMaxDeviation = 2.0;
+		
+		allocPartials(mPartials);
+		allocPartials(mSpare);
+		
+		mPeakFreqs = new double[maxPartials];
+		mPeakAmps = new double[maxPartials];
+		mSum = new double[kBlockSize * 2];
+	}
+	
+	~HISSTools_Oscillator_Bank()
+	{
+		freePartials(mPartials);
+		freePartials(mSpare);
+		
+		delete[] mPeakFreqs;
+		delete[] mPeakAmps;
+		delete[] mSum;
+	}
+
+
+private:
+
+	void allocPartials(Partials& partials)
+	{
+		partials.phaseReal = new double[mMaxPartials];
+		partials.phaseImag = new double[mMaxPartials];
+		partials.rotorReal = new double[mMaxPartials];
+		partials.rotorImag = new double[mMaxPartials];
+		partials.stepReal = new double[mMaxPartials];
+		partials.stepImag = new double[mMaxPartials];
+		partials.amp = new double[mMaxPartials];
+		partials.ampStep = new double[mMaxPartials];
+		partials.freq = new double[mMaxPartials];
+		partials.targetAmp = new double[mMaxPartials];
+	}
+	
+	
+	void freePartials(Partials& partials)
+	{
+		delete[] partials.phaseReal;
+		delete[] partials.phaseImag;
+		delete[] partials.rotorReal;
+		delete[] partials.rotorImag;
+		delete[] partials.stepReal;
+		delete[] partials.stepImag;
+		delete[] partials.amp;
+		delete[] partials.ampStep;
+		delete[] partials.freq;
+		delete[] partials.targetAmp;
+	}
+	
+	
+	void addPartial(unsigned long& nPartials, double phaseReal, double phaseImag, double rotorReal, double rotorImag, double amp, double freq, double targetAmp, unsigned long rampSamples)
+	{
+		// Add a partial to the spare set, setting the steps that ramp from the current rotor and amplitude to the targets
+		
+		if (nPartials == mMaxPartials)
+			return;
+		
+		double current = atan2(rotorImag, rotorReal);
+		double step = (2.0 * M_PI * freq - (current < 0.0 ? current + 2.0 * M_PI : current)) / rampSamples;
+		unsigned long i = nPartials++;
+		
+		mSpare.phaseReal[i] = phaseReal;
+		mSpare.phaseImag[i] = phaseImag;
+		mSpare.rotorReal[i] = rotorReal;
+		mSpare.rotorImag[i] = rotorImag;
+		mSpare.stepReal[i] = cos(step);
+		mSpare.stepImag[i] = sin(step);
+		mSpare.amp[i] = amp;
+		mSpare.ampStep[i] = (targetAmp - amp) / rampSamples;
+		mSpare.freq[i] = freq;
+		mSpare.targetAmp[i] = targetAmp;
+	}
+	
+	
+	void continuePartial(unsigned long& nPartials, unsigned long i, double freq, double targetAmp, unsigned long rampSamples)
+	{
+		// Partials that are fading out and are already (effectively) silent are dropped
+		// N.B. - the amplitude of a partial whose ramp is interrupted is accumulated, so is rarely exactly zero
+		
+		const double silence = 1e-9;
+		
+		if (!targetAmp && fabs(mPartials.amp[i]) < silence)
+			return;
+		
+		addPartial(nPartials, mPartials.phaseReal[i], mPartials.phaseImag[i], mPartials.rotorReal[i], mPartials.rotorImag[i], mPartials.amp[i], freq, targetAmp, rampSamples);
+	}
+	
+	
+	void matchPeaks(unsigned long nPeaks, unsigned long FFTSize, unsigned long rampSamples)
+	{
+		// Match peaks to partials in order of frequency (each partial takes the nearest peak within the maximum deviation)
+		// The new set of partials is built in the spare arrays (in order of frequency) and then swapped with the current set
+		
+		double maxDeviation = mMaxDeviation / (FFTSize ? FFTSize : 1);
+		double *freqs = mPartials.freq;
+		
+		unsigned long nPartials = 0;
+		unsigned long i, j;
+		
+		rampSamples = rampSamples ? rampSamples : 1;
+		
+		for (i = 0, j = 0; i < nPeaks; i++)
+		{
+			double freq = mPeakFreqs[i];
+			
+			// Partials below the peak (or nearer to the next partial) die
+			
+			for (; j < mNPartials && freqs[j] < freq - maxDeviation; j++)
+				continuePartial(nPartials, j, freqs[j], 0.0, rampSamples);
+			
+			for (; j + 1 < mNPartials && fabs(freqs[j + 1] - freq) < fabs(freqs[j] - freq); j++)
+				continuePartial(nPartials, j, freqs[j], 0.0, rampSamples);
+			
+			// Continue the partial if it is in range (and the next peak is not nearer) or otherwise start a new partial
+			
+			if (j < mNPartials && fabs(freqs[j] - freq) <= maxDeviation && (i + 1 == nPeaks || fabs(freqs[j] - freq) <= fabs(freqs[j] - mPeakFreqs[i + 1])))
+				continuePartial(nPartials, j++, freq, mPeakAmps[i], rampSamples);
+			else
+				addPartial(nPartials, 1.0, 0.0, cos(2.0 * M_PI * freq), sin(2.0 * M_PI * freq), 0.0, freq, mPeakAmps[i], rampSamples);
+		}
+		
+		for (; j < mNPartials; j++)
+			continuePartial(nPartials, j, freqs[j], 0.0, rampSamples);
+		
+		std::swap(mPartials, mSpare);
+		mNPartials = nPartials;
+		mRampRemaining = rampSamples;
+	}
+	
+	
+	void endRamp()
+	{
+		// Set the exact target values and remove partials that have faded out (keeping the order of frequency)
+		
+		unsigned long nPartials = 0;
+		
+		for (unsigned long i = 0; i < mNPartials; i++)
+		{
+			if (!mPartials.targetAmp[i])
+				continue;
+			
+			mPartials.phaseReal[nPartials] = mPartials.phaseReal[i];
+			mPartials.phaseImag[nPartials] = mPartials.phaseImag[i];
+			mPartials.rotorReal[nPartials] = cos(2.0 * M_PI * mPartials.freq[i]);
+			mPartials.rotorImag[nPartials] = sin(2.0 * M_PI * mPartials.freq[i]);
+			mPartials.amp[nPartials] = mPartials.targetAmp[i];
+			mPartials.freq[nPartials] = mPartials.freq[i];
+			mPartials.targetAmp[nPartials] = mPartials.targetAmp[i];
+			nPartials++;
+		}
+		
+		mNPartials = nPartials;
+	}
+	
+	
+	template <bool ramp>
+	void synthesise(double *output, unsigned long nSamps)
+	{
+		// Sum the partials for up to kBlockSize samples (the rotors and amplitudes are only stepped whilst ramping)
+		
+		double *phaseReal = mPartials.phaseReal;
+		double *phaseImag = mPartials.phaseImag;
+		double *rotorReal = mPartials.rotorReal;
+		double *rotorImag = mPartials.rotorImag;
+		double *stepReal = mPartials.stepReal;
+		double *stepImag = mPartials.stepImag;
+		double *amp = mPartials.amp;
+		double *ampStep = mPartials.ampStep;
+		
+		unsigned long i = 0;
+		unsigned long j;
+		
+		for (j = 0; j < nSamps; j++)
+			output[j] = 0.0;
+
+#ifdef HISSTOOLS_OSCILLATOR_BANK_SSE2
+
+		// Four partials at a time (as two independent pairs) with the sums for each pair of lanes interleaved
+		
+		for (j = 0; j < (nSamps << 1); j++)
+			mSum[j] = 0.0;
+		
+		for (; i + 4 <= mNPartials; i += 4)
+		{
+			__m128d zr1 = _mm_loadu_pd(phaseReal + i), zr2 = _mm_loadu_pd(phaseReal + i + 2);
+			__m128d zi1 = _mm_loadu_pd(phaseImag + i), zi2 = _mm_loadu_pd(phaseImag + i + 2);
+			__m128d rr1 = _mm_loadu_pd(rotorReal + i), rr2 = _mm_loadu_pd(rotorReal + i + 2);
+			__m128d ri1 = _mm_loadu_pd(rotorImag + i), ri2 = _mm_loadu_pd(rotorImag + i + 2);
+			__m128d sr1 = _mm_loadu_pd(stepReal + i), sr2 = _mm_loadu_pd(stepReal + i + 2);
+			__m128d si1 = _mm_loadu_pd(stepImag + i), si2 = _mm_loadu_pd(stepImag + i + 2);
+			__m128d a1 = _mm_loadu_pd(amp + i), a2 = _mm_loadu_pd(amp + i + 2);
+			__m128d da1 = _mm_loadu_pd(ampStep + i), da2 = _mm_loadu_pd(ampStep + i + 2);
+			
+			for (j = 0; j < nSamps; j++)
+			{
+				__m128d sum = _mm_add_pd(_mm_mul_pd(a1, zi1), _mm_mul_pd(a2, zi2));
+				__m128d temp1 = _mm_sub_pd(_mm_mul_pd(zr1, rr1), _mm_mul_pd(zi1, ri1));
+				__m128d temp2 = _mm_sub_pd(_mm_mul_pd(zr2, rr2), _mm_mul_pd(zi2, ri2));
+				
+				_mm_storeu_pd(mSum + (j << 1), _mm_add_pd(_mm_loadu_pd(mSum + (j << 1)), sum));
+				
+				zi1 = _mm_add_pd(_mm_mul_pd(zr1, ri1), _mm_mul_pd(zi1, rr1));
+				zi2 = _mm_add_pd(_mm_mul_pd(zr2, ri2), _mm_mul_pd(zi2, rr2));
+				zr1 = temp1;
+				zr2 = temp2;
+				
+				if (ramp)
+				{
+					temp1 = _mm_sub_pd(_mm_mul_pd(rr1, sr1), _mm_mul_pd(ri1, si1));
+					temp2 = _mm_sub_pd(_mm_mul_pd(rr2, sr2), _mm_mul_pd(ri2, si2));
+					ri1 = _mm_add_pd(_mm_mul_pd(rr1, si1), _mm_mul_pd(ri1, sr1));
+					ri2 = _mm_add_pd(_mm_mul_pd(rr2, si2), _mm_mul_pd(ri2, sr2));
+					rr1 = temp1;
+					rr2 = temp2;
+					a1 = _mm_add_pd(a1, da1);
+					a2 = _mm_add_pd(a2, da2);
+				}
+			}
+			
+			_mm_storeu_pd(phaseReal + i, zr1);
+			_mm_storeu_pd(phaseReal + i + 2, zr2);
+			_mm_storeu_pd(phaseImag + i, zi1);
+			_mm_storeu_pd(phaseImag + i + 2, zi2);
+			
+			if (ramp)
+			{
+				_mm_storeu_pd(rotorReal + i, rr1);
+				_mm_storeu_pd(rotorReal + i + 2, rr2);
+				_mm_storeu_pd(rotorImag + i, ri1);
+				_mm_storeu_pd(rotorImag + i + 2, ri2);
+				_mm_storeu_pd(amp + i, a1);
+				_mm_storeu_pd(amp + i + 2, a2);
+			}
+		}
+		
+		for (j = 0; j < nSamps; j++)
+			output[j] = mSum[(j << 1)] + mSum[(j << 1) + 1];
+#endif
+
+		// Remaining partials
+		
+		for (; i < mNPartials; i++)
+		{
+			double zr = phaseReal[i];
+			double zi = phaseImag[i];
+			double rr = rotorReal[i];
+			double ri = rotorImag[i];
+			double a = amp[i];
+			
+			for (j = 0; j < nSamps; j++)
+			{
+				double temp = zr * rr - zi * ri;
+				
+				output[j] += a * zi;
+				zi = zr * ri + zi * rr;
+				zr = temp;
+				
+				if (ramp)
+				{
+					temp = rr * stepReal[i] - ri * stepImag[i];
+					ri = rr * stepImag[i] + ri * stepReal[i];
+					rr = temp;
+					a += ampStep[i];
+				}
+			}
+			
+			phaseReal[i] = zr;
+			phaseImag[i] = zi;
+			rotorReal[i] = rr;
+			rotorImag[i] = ri;
+			amp[i] = a;
+		}
+		
+		// Renormalise the phases
+		
+		for (i = 0; i < mNPartials; i++)
+		{
+			double norm = 1.0 / sqrt(phaseReal[i] * phaseReal[i] + phaseImag[i] * phaseImag[i]);
+			
+			phaseReal[i] *= norm;
+			phaseImag[i] *= norm;
+		}
+	}
+
+
+public:
+
+	void setMaxDeviation(double bins)
+	{
+		// Maximum frequency change (in bins of the peak frame) for a peak to continue a partial
+		
+		mMaxDeviation = bins > 0.0 ? bins : 0.0;
+	}
+	
+	
+	void reset()
+	{
+		mNPartials = 0;
+		mRampRemaining = 0;
+	}
+	
+	
+	unsigned long getNPartials()
+	{
+		return mNPartials;
+	}
+	
+	
+	// Set the next frame of peaks, which is reached after rampSamples (peaks beyond the maximum number of partials are ignored)
+	
+	void setPeaks(const SpectralPeakFrame *frame, unsigned long rampSamples, double gain = 1.0, bool fromPower = FALSE)
+	{
+		unsigned long nPeaks = std::min(frame->nPeaks, mMaxPartials);
+		
+		for (unsigned long i = 0; i < nPeaks; i++)
+		{
+			mPeakFreqs[i] = frame->peakFreqs[i];
+			mPeakAmps[i] = gain * (fromPower == TRUE ? sqrt(std::max(0.0, frame->peakAmps[i])) : frame->peakAmps[i]);
+		}
+		
+		matchPeaks(nPeaks, frame->FFTSize, rampSamples);
+	}
+	
+	
+	void setPeaks(const FFTPeak *peaks, unsigned long nPeaks, unsigned long FFTSize, unsigned long rampSamples, double gain = 1.0, bool fromPower = FALSE)
+	{
+		nPeaks = std::min(nPeaks, mMaxPartials);
+		
+		for (unsigned long i = 0; i < nPeaks; i++)
+		{
+			mPeakFreqs[i] = peaks[i].peakFreq;
+			mPeakAmps[i] = gain * (fromPower == TRUE ? sqrt(std::max(0.0, peaks[i].peakAmp)) : peaks[i].peakAmp);
+		}
+		
+		matchPeaks(nPeaks, FFTSize, rampSamples);
+	}
+	
+	
+	void process(double *output, unsigned long nSamps)
+	{
+		// Write the next nSamps samples (holding the last frame once its ramp is complete)
+		
+		while (nSamps)
+		{
+			unsigned long blockSize = nSamps < kBlockSize ? nSamps : kBlockSize;
+			
+			if (mRampRemaining)
+			{
+				blockSize = std::min(blockSize, mRampRemaining);
+				synthesise<true>(output, blockSize);
+				
+				if (!(mRampRemaining -= blockSize))
+					endRamp();
+			}
+			else
+				synthesise<false>(output, blockSize);
+			
+			output += blockSize;
+			nSamps -= blockSize;
+		}
+	}
+
+
+private:
+
+	// Partials
+	
+	Partials mPartials;
+	Partials mSpare;
+	
+	unsigned long mNPartials;
+	unsigned long mMaxPartials;
+	unsigned long mRampRemaining;
+	
+	double mMaxDeviation;
+	
+	// Peaks and Temporary Memory
+	
+	double *mPeakFreqs;
+	double *mPeakAmps;
+	double *mSum;
+};
+
+
+#endif
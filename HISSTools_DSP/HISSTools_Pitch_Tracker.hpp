@@ -0,0 +1,270 @@
+
+
+#ifndef __HISSTOOLS_PITCH_TRACKER__
+#define __HISSTOOLS_PITCH_TRACKER__
+
+
+#include "HISSTools_FFT.hpp"
+#include "HISSTools_Frame.hpp"
+#include "HISSTools_Spectral_Peaks.hpp"
+
+
+// Streaming fundamental frequency estimation (YIN) for frames from HISSTools_Frame
+//
+// The integration window is the first half of the frame, so the longest lag (lowest frequency) is just under half the frame size
+// The difference function is formed from the energies and the cross-correlation of the window with the frame, which is calculated by FFT
+// Only one FFT size (the frame size rounded up to a power of two) is needed, as the zero padded window cannot wrap the circular correlation
+//
+// Each frame costs two forward FFTs and one inverse FFT, plus linear time passes, in place of the O(N^2) direct difference function
+
+
+class HISSTools_Pitch_Tracker : public HISSTools_Frame, protected HISSTools_FFT, protected HISSTools_FSpectrum
+{
+
+public:
+
+	HISSTools_Pitch_Tracker(unsigned long maxFrameSize) : HISSTools_Frame(maxFrameSize, 1), HISSTools_FFT(calcFFTSize(maxFrameSize)), HISSTools_FSpectrum(calcFFTSize(maxFrameSize), kSpectrumComplex)
+	{
+		mMaxFFTSize = calcFFTSize(maxFrameSize);
+		
+		mWindowReal = new double[mMaxFFTSize];
+		mWindowImag = new double[mMaxFFTSize];
+		mCorrelation = new double[mMaxFFTSize];
+		mDifference = new double[(mMaxFFTSize >> 1) + 1];
+		
+		mSamplingRate = 44100.0;
+		mMinFrequency = 50.0;
+		mMaxFrequency = 2000.0;
+		mThreshold = 0.1;
+		
+		mFrequency = 0.0;
+		mAperiodicity = 1.0;
+		mVoiced = FALSE;
+	}
+	
+	~HISSTools_Pitch_Tracker()
+	{
+		delete[] mWindowReal;
+		delete[] mWindowImag;
+		delete[] mCorrelation;
+		delete[] mDifference;
+	}
+
+
+private:
+
+	static unsigned long calcFFTSize(unsigned long frameSize)
+	{
+		unsigned long FFTSize = 4;
+		
+		while (FFTSize < frameSize)
+			FFTSize <<= 1;
+		
+		return FFTSize;
+	}
+	
+	
+	void output(double frequency, double aperiodicity, bool voiced, double fractionalOffset)
+	{
+		mFrequency = frequency;
+		mAperiodicity = aperiodicity;
+		mVoiced = voiced;
+		
+		processPitch(frequency, aperiodicity, voiced, fractionalOffset);
+	}
+
+
+protected:
+
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *this->getSpectrum();
+		
+		double *windowReal = mWindowReal;
+		double *windowImag = mWindowImag;
+		double *correlation = mCorrelation;
+		double *difference = mDifference;
+		
+		double energyWindow = 0.0;
+		double energyLag;
+		double runningSum = 0.0;
+		double refinedLag;
+		double minimum;
+		
+		unsigned long window = frameSize >> 1;
+		unsigned long FFTSize = calcFFTSize(frameSize);
+		unsigned long minLag = (unsigned long) std::max(2.0, floor(mSamplingRate / mMaxFrequency));
+		unsigned long maxLag = (unsigned long) std::max(0.0, ceil(mSamplingRate / mMinFrequency));
+		unsigned long lag = 0;
+		unsigned long i;
+		
+		bool voiced = FALSE;
+		
+		// Clip the lag range to the integration window (keeping a lag either side of the search for interpolation)
+		
+		maxLag = window > 2 ? std::min(maxLag, window - 2) : 0;
+		
+		if (frameSize > mMaxFFTSize || minLag >= maxLag)
+		{
+			output(0.0, 1.0, FALSE, fractionalOffset);
+			return;
+		}
+		
+		// Spectrum of the integration window (zero padded)
+		
+		if (timeToSpectrum(iFrame, this, window, FFTSize, mSamplingRate) == FALSE)
+			return;
+		
+		for (i = 0; i < FFTSize; i++)
+		{
+			windowReal[i] = FFTData.realp[i];
+			windowImag[i] = FFTData.imagp[i];
+		}
+		
+		// Spectrum of the whole frame and the cross spectrum (conjugate of the window multiplied by the frame)
+		
+		if (timeToSpectrum(iFrame, this, frameSize, FFTSize, mSamplingRate) == FALSE)
+			return;
+		
+		for (i = 0; i < FFTSize; i++)
+		{
+			double real = FFTData.realp[i];
+			double imag = FFTData.imagp[i];
+			
+			FFTData.realp[i] = (windowReal[i] * real) + (windowImag[i] * imag);
+			FFTData.imagp[i] = (windowReal[i] * imag) - (windowImag[i] * real);
+		}
+		
+		// Cross-correlation of the window with the frame
+		
+		if (spectrumToTime(correlation, this) == FALSE)
+			return;
+		
+		// Difference function (from the energies and the correlation) and the cumulative mean normalised difference
+		
+		for (i = 0; i < window; i++)
+			energyWindow += iFrame[i] * iFrame[i];
+		
+		energyLag = energyWindow;
+		difference[0] = 1.0;
+		
+		for (i = 1; i <= maxLag + 1; i++)
+		{
+			energyLag += (iFrame[i + window - 1] * iFrame[i + window - 1]) - (iFrame[i - 1] * iFrame[i - 1]);
+			
+			double value = std::max(0.0, energyWindow + energyLag - 2.0 * correlation[i]);
+			
+			runningSum += value;
+			difference[i] = runningSum > 0.0 ? (value * i) / runningSum : 1.0;
+		}
+		
+		// Absolute threshold (taking the local minimum following the first crossing)
+		
+		for (i = minLag; i <= maxLag; i++)
+		{
+			if (difference[i] < mThreshold)
+			{
+				while (i < maxLag && difference[i + 1] < difference[i])
+					i++;
+				
+				lag = i;
+				voiced = TRUE;
+				break;
+			}
+		}
+		
+		// Fall back to the global minimum when no lag falls below the threshold
+		
+		if (!lag)
+		{
+			for (i = minLag, lag = minLag; i <= maxLag; i++)
+				lag = difference[i] < difference[lag] ? i : lag;
+		}
+		
+		// Parabolic refinement of the lag and the aperiodicity
+		
+		refinedLag = HISSTools_Spectral_Peaks::interpolatePeak(difference[lag - 1], difference[lag], difference[lag + 1], lag, 1, &minimum);
+		
+		if (refinedLag <= 0.0)
+			refinedLag = lag;
+		
+		output(mSamplingRate / refinedLag, std::max(0.0, std::min(1.0, minimum)), voiced, fractionalOffset);
+	}
+	
+	
+	void virtual processPitch(double frequency, double aperiodicity, bool voiced, double fractionalOffset)
+	{
+		// This function should be overridden to receive an estimate for each frame (the last estimate is also available from the getters)
+	}
+
+
+public:
+
+	void setSamplingRate(double samplingRate)
+	{
+		mSamplingRate = samplingRate > 0.0 ? samplingRate : 44100.0;
+	}
+	
+	
+	void setRange(double minFrequency, double maxFrequency)
+	{
+		// The lowest frequency is also limited by the frame size (the longest lag is just under half the frame)
+		
+		mMinFrequency = std::max(1.0, std::min(minFrequency, maxFrequency));
+		mMaxFrequency = std::max(1.0, std::max(minFrequency, maxFrequency));
+	}
+	
+	
+	void setThreshold(double threshold)
+	{
+		mThreshold = threshold;
+	}
+	
+	
+	double getFrequency()
+	{
+		return mFrequency;
+	}
+	
+	
+	double getAperiodicity()
+	{
+		return mAperiodicity;
+	}
+	
+	
+	bool getVoiced()
+	{
+		return mVoiced;
+	}
+
+
+private:
+
+	// Data
+	
+	double *mWindowReal;
+	double *mWindowImag;
+	double *mCorrelation;
+	double *mDifference;
+	
+	// Parameters
+	
+	double mSamplingRate;
+	double mMinFrequency;
+	double mMaxFrequency;
+	double mThreshold;
+	
+	// Output
+	
+	double mFrequency;
+	double mAperiodicity;
+	bool mVoiced;
+	
+	// Maximums
+	
+	unsigned long mMaxFFTSize;
+};
+
+
+#endif
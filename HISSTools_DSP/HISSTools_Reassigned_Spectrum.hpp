@@ -0,0 +1,282 @@
+
+
+#ifndef __HISSTOOLS_REASSIGNED_SPECTRUM__
+#define __HISSTOOLS_REASSIGNED_SPECTRUM__
+
+
+#include "HISSTools_FFT.hpp"
+#include "HISSTools_Frame.hpp"
+
+
+// Reassigned spectrogram (or frequency only reassignment / synchrosqueezing) for streaming input
+//
+// Frames are analysed with a periodic Hann window - the window and derivative window spectra are both formed from a single FFT of the
+// unwindowed frame (as three and two bin spectral convolutions) so only two FFTs are needed per frame (the second for the time-ramped window)
+//
+// Energy is accumulated into a ring of grid columns (one column per hop, one row per FFT bin) and completed columns are passed to processColumn()
+// Memory is bounded by the minimum hop size given at construction, and the output latency is ((frameSize / 2) / hopSize + 1) hops
+
+
+enum ReassignmentModes {
+
+	kReassignTimeFrequency = 0,
+	kReassignFrequency = 1,
+};
+
+
+class HISSTools_Reassigned_Spectrum : public HISSTools_Frame, protected HISSTools_FFT, protected HISSTools_FSpectrum
+{
+
+public:
+
+	HISSTools_Reassigned_Spectrum(unsigned long maxFrameSize, unsigned long minHopSize) : HISSTools_Frame(maxFrameSize, 1), HISSTools_FFT(maxFrameSize), HISSTools_FSpectrum(maxFrameSize, kSpectrumComplex)
+	{
+		mMaxFrameSize = maxFrameSize;
+		mMinHopSize = std::max(1UL, minHopSize);
+		mMaxColumns = 2 * ((mMaxFrameSize / 2 + 1) / mMinHopSize + 1) + 2;
+		
+		mRampedFrame = new double[mMaxFrameSize];
+		mFrameSpectrumReal = new double[(mMaxFrameSize >> 1) + 1];
+		mFrameSpectrumImag = new double[(mMaxFrameSize >> 1) + 1];
+		mGrid = new double[mMaxColumns * ((mMaxFrameSize >> 1) + 1)];
+		
+		mMode = kReassignTimeFrequency;
+		mThreshold = 1e-12;
+		
+		setParams(mMaxFrameSize, mMaxFrameSize >> 2);
+	}
+	
+	~HISSTools_Reassigned_Spectrum()
+	{
+		delete[] mRampedFrame;
+		delete[] mFrameSpectrumReal;
+		delete[] mFrameSpectrumImag;
+		delete[] mGrid;
+	}
+
+
+private:
+
+	double *getColumn(unsigned long long column)
+	{
+		return mGrid + (column % mNColumns) * ((mFrameSize >> 1) + 1);
+	}
+	
+	
+	void clearGrid()
+	{
+		for (unsigned long i = 0; i < mMaxColumns * ((mMaxFrameSize >> 1) + 1); i++)
+			mGrid[i] = 0.;
+		
+		mFrameCount = 0;
+		mNextColumn = 0;
+	}
+
+
+protected:
+
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *this->getSpectrum();
+		
+		double *real = mFrameSpectrumReal;
+		double *imag = mFrameSpectrumImag;
+		double *rampedFrame = mRampedFrame;
+		
+		double centre = frameSize * 0.5;
+		double binsPerRadian = frameSize / (2.0 * M_PI);
+		double derivativeScale = M_PI / (2.0 * frameSize);
+		double hopRecip = 1.0 / mHopSize;
+		double offset = fractionalOffset ? 1.0 - fractionalOffset : 0.0;
+		double maxPower = 0.0;
+		
+		unsigned long nBins = (frameSize >> 1) + 1;
+		unsigned long long frame = mFrameCount;
+		unsigned long i;
+		
+		// Check that the frame size matches the current settings (which are enforced as powers of two)
+		
+		if (frameSize != mFrameSize)
+			return;
+		
+		// Unwindowed FFT (store the positive frequencies)
+		
+		if (timeToSpectrum(iFrame, this, frameSize, frameSize, 44100.0) == FALSE)
+			return;
+		
+		for (i = 0; i < nBins; i++)
+		{
+			real[i] = FFTData.realp[i];
+			imag[i] = FFTData.imagp[i];
+		}
+		
+		// Time-ramped Hann window FFT
+		
+		for (i = 0; i < frameSize; i++)
+			rampedFrame[i] = iFrame[i] * (i - centre) * (0.5 - 0.5 * cos(2.0 * M_PI * i / frameSize));
+		
+		if (timeToSpectrum(rampedFrame, this, frameSize, frameSize, 44100.0) == FALSE)
+			return;
+		
+		// Window spectrum from the unwindowed spectrum (using conjugate symmetry at DC and Nyquist) - the power is stored in the ramped frame memory
+		
+		for (i = 0; i < nBins; i++)
+		{
+			double hReal = 0.5 * real[i] - 0.25 * ((i ? real[i - 1] : real[1]) + ((i < nBins - 1) ? real[i + 1] : real[i - 1]));
+			double hImag = 0.5 * imag[i] - 0.25 * ((i ? imag[i - 1] : -imag[1]) + ((i < nBins - 1) ? imag[i + 1] : -imag[i - 1]));
+			
+			rampedFrame[i] = (hReal * hReal) + (hImag * hImag);
+			maxPower = rampedFrame[i] > maxPower ? rampedFrame[i] : maxPower;
+		}
+		
+		// Reassign and scatter each bin above the threshold
+		
+		double threshold = maxPower * mThreshold;
+		
+		for (i = 0; i < nBins; i++)
+		{
+			double power = rampedFrame[i];
+			
+			if (power <= threshold || power == 0.0)
+				continue;
+			
+			// Neighbouring bins (using conjugate symmetry at DC and Nyquist)
+			
+			double rLo = i ? real[i - 1] : real[1];
+			double iLo = i ? imag[i - 1] : -imag[1];
+			double rHi = (i < nBins - 1) ? real[i + 1] : real[i - 1];
+			double iHi = (i < nBins - 1) ? imag[i + 1] : -imag[i - 1];
+			
+			// Window and derivative window spectra from the unwindowed spectrum
+			
+			double hReal = 0.5 * real[i] - 0.25 * (rLo + rHi);
+			double hImag = 0.5 * imag[i] - 0.25 * (iLo + iHi);
+			double dReal = derivativeScale * (iLo - iHi);
+			double dImag = -derivativeScale * (rLo - rHi);
+			
+			// Reassignment operators (frequency in bins / time in samples from the frame centre)
+			
+			double powerRecip = 1.0 / power;
+			double frequency = i - binsPerRadian * ((dImag * hReal) - (dReal * hImag)) * powerRecip;
+			double time = ((FFTData.realp[i] * hReal) + (FFTData.imagp[i] * hImag)) * powerRecip;
+			
+			long bin = (long) floor(frequency + 0.5);
+			
+			if (bin < 0 || bin >= (long) nBins || fabs(time) > centre)
+				continue;
+			
+			long long column = (long long) frame;
+			
+			if (mMode == kReassignTimeFrequency)
+				column += (long long) floor((time + offset) * hopRecip + 0.5);
+			
+			if (column < (long long) mNextColumn || column > (long long) (frame + mReach))
+				continue;
+			
+			getColumn(column)[bin] += power;
+		}
+		
+		// Output completed columns (no later frame can reach them)
+		
+		for (; mNextColumn + mReach <= frame; mNextColumn++)
+		{
+			double *column = getColumn(mNextColumn);
+			
+			processColumn(column, nBins);
+			
+			for (i = 0; i < nBins; i++)
+				column[i] = 0.;
+		}
+		
+		mFrameCount++;
+	}
+	
+	
+	void virtual processColumn(const double *column, unsigned long nBins)
+	{
+		// This function should be overridden to receive completed columns of the reassigned grid (one per hop)
+	}
+
+
+public:
+
+	void setParams(unsigned long frameSize, unsigned long hopSize)
+	{
+		// The frame size is forced to a power of two and the hop size to the minimum given at construction
+		
+		frameSize = std::max(4UL, std::min(mMaxFrameSize, frameSize));
+		frameSize = 1UL << ((HISSTools_FFT *) this)->log2(frameSize);
+		frameSize = frameSize > mMaxFrameSize ? frameSize >> 1 : frameSize;
+		
+		hopSize = std::max(mMinHopSize, hopSize);
+		
+		mFrameSize = frameSize;
+		mHopSize = hopSize;
+		mReach = (frameSize / 2 + 1) / hopSize + 1;
+		mNColumns = std::min(mMaxColumns, 2 * mReach + 2);
+		
+		clearGrid();
+		HISSTools_Frame::setParams(frameSize, (double) hopSize, TRUE);
+	}
+	
+	
+	void setMode(ReassignmentModes mode)
+	{
+		mMode = mode;
+	}
+	
+	
+	void setThreshold(double dB)
+	{
+		// Bins more than this far below the loudest bin in the frame are not reassigned
+		
+		mThreshold = pow(10.0, dB / 10.0);
+	}
+	
+	
+	void reset()
+	{
+		clearGrid();
+		HISSTools_Frame::reset();
+	}
+	
+	
+	unsigned long getLatencyHops()
+	{
+		return mReach;
+	}
+
+
+private:
+
+	// Data
+	
+	double *mRampedFrame;
+	double *mFrameSpectrumReal;
+	double *mFrameSpectrumImag;
+	double *mGrid;
+	
+	// Parameters
+	
+	ReassignmentModes mMode;
+	double mThreshold;
+	
+	unsigned long mFrameSize;
+	unsigned long mHopSize;
+	unsigned long mReach;
+	unsigned long mNColumns;
+	
+	// Counters
+	
+	unsigned long long mFrameCount;
+	unsigned long long mNextColumn;
+	
+	// Maximums
+	
+	unsigned long mMaxFrameSize;
+	unsigned long mMinHopSize;
+	unsigned long mMaxColumns;
+};
+
+
+#endif
@@ -0,0 +1,388 @@
+
+
+#ifndef __HISSTOOLS_RESAMPLER__
+#define __HISSTOOLS_RESAMPLER__
+
+#include <cmath>
+#include <algorithm>
+
+#include "../HISSTools_Utility/HISSTools_State.hpp"
+
+
+// Streaming polyphase resampler (Kaiser windowed sinc)
+//
+// Integer rate pairs that reduce to a manageable number of phases use exact rational stepping (one filter per phase)
+// Other ratios use a table of filter phases, linearly interpolating between the two nearest phases
+//
+// The filter is stored time-reversed against a doubled history buffer so that each output is a single contiguous dot product
+// Output sample n corresponds to input time (n * getStep() - getLatency()) measured in input samples since the last reset
+
+
+class HISSTools_Resampler
+{
+
+public:
+
+	enum ResamplerMode {kResampleRational, kResampleArbitrary};
+	
+	
+	HISSTools_Resampler(unsigned long maxChans, unsigned long halfTaps = 16) : mMaxChans(std::max(1UL, std::min(256UL, maxChans))), mHalfTaps(std::max(2UL, halfTaps))
+	{
+		mFilters = NULL;
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			mHistory[i] = NULL;
+		
+		mNTaps = 0;
+		mNPhases = 0;
+		
+		setRates(1.0, 1.0);
+	}
+	
+	
+	~HISSTools_Resampler()
+	{
+		delete[] mFilters;
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			delete[] mHistory[i];
+	}
+
+
+private:
+
+	static double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		double halfXSq = 0.25 * x * x;
+		
+		for (unsigned long i = 1; i < 64 && term > 1e-16 * sum; i++)
+		{
+			term *= halfXSq / (double) (i * i);
+			sum += term;
+		}
+		
+		return sum;
+	}
+	
+	
+	void makeFilter(double *filter, double phase, double cutoff)
+	{
+		// Filter taps are stored time-reversed (so they line up with the oldest to newest history)
+		
+		double centre = mNTaps * 0.5;
+		double I0Beta = besselI0(kKaiserBeta);
+		
+		for (unsigned long i = 0; i < mNTaps; i++)
+		{
+			double t = (mNTaps - 1 - i) + phase - centre;
+			double x = t / centre;
+			double window = fabs(x) < 1.0 ? besselI0(kKaiserBeta * sqrt(1.0 - x * x)) / I0Beta : 0.0;
+			double sinc = t ? sin(M_PI * cutoff * t) / (M_PI * cutoff * t) : 1.0;
+			
+			filter[i] = cutoff * sinc * window;
+		}
+	}
+	
+	
+	static double dotProduct(const double *a, const double *b, unsigned long size)
+	{
+		double sum = 0.0;
+		
+		for (unsigned long i = 0; i < size; i++)
+			sum += a[i] * b[i];
+		
+		return sum;
+	}
+
+
+public:
+
+	bool setRates(double inRate, double outRate)
+	{
+		// N.B. this allocates memory and is not threadsafe
+		
+		if (inRate <= 0.0 || outRate <= 0.0)
+			return FALSE;
+		
+		double ratio = outRate / inRate;
+		double cutoff = std::min(1.0, ratio) * kCutoff;
+		
+		unsigned long nTaps = 2 * (unsigned long) ceil(mHalfTaps / std::min(1.0, ratio));
+		unsigned long nPhases = kArbitraryPhases + 1;
+		unsigned long i;
+		
+		mMode = kResampleArbitrary;
+		mInterpolation = 1;
+		mDecimation = 1;
+		
+		// Rational ratio (integer rates with a small enough number of phases)
+		
+		if (inRate == floor(inRate) && outRate == floor(outRate) && inRate < 4294967296.0 && outRate < 4294967296.0)
+		{
+			unsigned long long a = (unsigned long long) inRate;
+			unsigned long long b = (unsigned long long) outRate;
+			
+			while (b)
+			{
+				unsigned long long c = a % b;
+				a = b;
+				b = c;
+			}
+			
+			if ((unsigned long long) outRate / a <= kMaxRationalPhases)
+			{
+				mMode = kResampleRational;
+				mInterpolation = (unsigned long) ((unsigned long long) outRate / a);
+				mDecimation = (unsigned long) ((unsigned long long) inRate / a);
+				nPhases = mInterpolation;
+			}
+		}
+		
+		// Allocate
+		
+		if (nTaps != mNTaps || nPhases != mNPhases)
+		{
+			delete[] mFilters;
+			mFilters = new double[nTaps * nPhases];
+			
+			for (i = 0; i < mMaxChans; i++)
+			{
+				delete[] mHistory[i];
+				mHistory[i] = new double[nTaps * 2];
+			}
+			
+			mNTaps = nTaps;
+			mNPhases = nPhases;
+		}
+		
+		// Calculate filters
+		
+		for (i = 0; i < nPhases; i++)
+			makeFilter(mFilters + (i * nTaps), i / (double) (mMode == kResampleRational ? nPhases : kArbitraryPhases), cutoff);
+		
+		mStep = inRate / outRate;
+		
+		reset();
+		
+		return TRUE;
+	}
+	
+	
+	void reset()
+	{
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			std::fill_n(mHistory[i], mNTaps * 2, 0.0);
+		
+		mHistoryPointer = 0;
+		mSamplesUntilOutput = 1;
+		mRationalPhase = 0;
+		mPhase = 0.0;
+	}
+	
+	
+	unsigned long process(double **ins, double **outs, unsigned long nChans, unsigned long nSamps)
+	{
+		// Outputs must hold at least getMaxOutput(nSamps) samples - returns the number of samples output
+		
+		unsigned long nTaps = mNTaps;
+		unsigned long historyPointer = mHistoryPointer;
+		unsigned long samplesUntilOutput = mSamplesUntilOutput;
+		unsigned long rationalPhase = mRationalPhase;
+		unsigned long nOut = 0;
+		double phase = mPhase;
+		
+		nChans = std::min(nChans, mMaxChans);
+		
+		// Channels are processed in turn, each from the same starting state
+		
+		for (unsigned long i = 0; i < nChans; i++)
+		{
+			const double *in = ins[i];
+			double *out = outs[i];
+			double *history = mHistory[i];
+			
+			historyPointer = mHistoryPointer;
+			samplesUntilOutput = mSamplesUntilOutput;
+			rationalPhase = mRationalPhase;
+			phase = mPhase;
+			nOut = 0;
+			
+			for (unsigned long j = 0; j < nSamps; j++)
+			{
+				// Write into the doubled history (the latest nTaps samples start at the write pointer)
+				
+				history[historyPointer] = history[historyPointer + nTaps] = in[j];
+				historyPointer = historyPointer + 1 == nTaps ? 0 : historyPointer + 1;
+				
+				// Calculate outputs that are now due
+				
+				for (--samplesUntilOutput; !samplesUntilOutput; )
+				{
+					const double *current = history + historyPointer;
+					
+					if (mMode == kResampleRational)
+					{
+						out[nOut++] = dotProduct(current, mFilters + (rationalPhase * nTaps), nTaps);
+						rationalPhase += mDecimation;
+						samplesUntilOutput = rationalPhase / mInterpolation;
+						rationalPhase -= samplesUntilOutput * mInterpolation;
+					}
+					else
+					{
+						double position = phase * kArbitraryPhases;
+						unsigned long index = std::min((unsigned long) position, kArbitraryPhases - 1);
+						double fract = position - index;
+						double lo = dotProduct(current, mFilters + (index * nTaps), nTaps);
+						double hi = dotProduct(current, mFilters + ((index + 1) * nTaps), nTaps);
+						
+						out[nOut++] = lo + fract * (hi - lo);
+						phase += mStep;
+						samplesUntilOutput = (unsigned long) floor(phase);
+						phase -= samplesUntilOutput;
+					}
+				}
+			}
+		}
+		
+		// Store state
+		
+		mHistoryPointer = historyPointer;
+		mSamplesUntilOutput = samplesUntilOutput;
+		mRationalPhase = rationalPhase;
+		mPhase = phase;
+		
+		return nOut;
+	}
+	
+	
+	unsigned long getMaxOutput(unsigned long nSamps)
+	{
+		return (unsigned long) ceil(nSamps / mStep) + 1;
+	}
+	
+	
+	double getStep()
+	{
+		return mStep;
+	}
+	
+	
+	double getLatency()
+	{
+		return mNTaps * 0.5;
+	}
+	
+	
+	ResamplerMode getMode()
+	{
+		return mMode;
+	}
+
+
+	// State
+	
+	unsigned long getStateSize()
+	{
+		HISSTools_StateWriter writer;
+		writeState(writer);
+		return writer.getPosition();
+	}
+	
+	
+	bool saveState(void *data, unsigned long size)
+	{
+		HISSTools_StateWriter writer(data, size);
+		writeState(writer);
+		return writer.isValid();
+	}
+	
+	
+	bool restoreState(const void *data, unsigned long size)
+	{
+		HISSTools_StateReader reader(data, size);
+		return readState(reader);
+	}
+	
+	
+	void writeState(HISSTools_StateWriter& writer)
+	{
+		unsigned long position = writer.beginState(kStateTagResampler, kStateVersion);
+		
+		writer.write(mMode);
+		writer.write(mStep);
+		writer.write(mNTaps);
+		writer.write(mMaxChans);
+		writer.write(mHistoryPointer);
+		writer.write(mSamplesUntilOutput);
+		writer.write(mRationalPhase);
+		writer.write(mPhase);
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			writer.write(mHistory[i], mNTaps * 2);
+		
+		writer.endState(position);
+	}
+	
+	
+	bool readState(HISSTools_StateReader& reader)
+	{
+		// The rates and filter must match (set them with setRates() before restoring)
+		
+		if (reader.beginState(kStateTagResampler, kStateVersion, getStateSize()) == FALSE)
+			return FALSE;
+		if (reader.check(mMode) == FALSE || reader.check(mStep) == FALSE || reader.check(mNTaps) == FALSE || reader.check(mMaxChans) == FALSE)
+			return FALSE;
+		
+		reader.read(mHistoryPointer);
+		reader.read(mSamplesUntilOutput);
+		reader.read(mRationalPhase);
+		reader.read(mPhase);
+		
+		for (unsigned long i = 0; i < mMaxChans; i++)
+			reader.read(mHistory[i], mNTaps * 2);
+		
+		return reader.isValid();
+	}
+
+
+private:
+
+	// Filter Design
+	
+	static constexpr double kKaiserBeta = 9.0;
+	static constexpr double kCutoff = 0.92;
+	static const unsigned long kArbitraryPhases = 256;
+	static const unsigned long kMaxRationalPhases = 1024;
+	static const uint32_t kStateVersion = 1;
+	
+	// Data
+	
+	double *mFilters;
+	double *mHistory[256];
+	
+	// Parameters
+	
+	ResamplerMode mMode;
+	double mStep;
+	unsigned long mInterpolation;
+	unsigned long mDecimation;
+	unsigned long mNTaps;
+	unsigned long mNPhases;
+	
+	// State
+	
+	unsigned long mHistoryPointer;
+	unsigned long mSamplesUntilOutput;
+	unsigned long mRationalPhase;
+	double mPhase;
+	
+	// Maximums
+	
+	const unsigned long mMaxChans;
+	const unsigned long mHalfTaps;
+};
+
+
+#endif
@@ -0,0 +1,394 @@
+
+
+#ifndef __HISSTOOLS_SPECTRAL_DENOISER__
+#define __HISSTOOLS_SPECTRAL_DENOISER__
+
+
+#include <chrono>
+
+#include "HISSTools_OLA.hpp"
+#include "HISSTools_Windows.hpp"
+#include "HISSTools_MultiTaper_Shrink.hpp"
+
+
+// Streaming multichannel spectral noise reduction (overlap-add via HISSTools_OLA)
+//
+// The power spectrum of each frame is estimated per channel with the wavelet shrunk multitaper spectrum
+// The tapers and the shrinkage give a low variance estimate from a single frame, so no cycle spinning or averaging over frames is required
+// The noise profile follows the estimate with asymmetric one-pole smoothing (as MODE_SMOOTH in HIRT_Frame_Stats) - a slow rise and fast fall tracks the floor
+// Wiener-style gains are applied to the spectrum of the sqrt Hann windowed frame, which is resynthesised with a matching window
+//
+// Frame sizes should be powers of two (others are zero padded) with an overlap of at least 2 (a hop of at most half the frame)
+// Time spent in each stage is accumulated so that the cost per hop can be checked against a budget
+// If the budget is exceeded the wavelet shrinkage is skipped (leaving the plain multitaper estimate) until the cost falls back within budget
+
+
+enum DenoiserStage {kDenoiseEstimate, kDenoiseNoise, kDenoiseGain, kDenoiseSynthesis, kDenoiseNumStages};
+
+
+class HISSTools_Spectral_Denoiser : public HISSTools_OLA, protected HISSTools_MultiTaper_Shrink, protected HISSTools_Windows
+{
+
+public:
+
+	HISSTools_Spectral_Denoiser(unsigned long maxFrameSize, unsigned long maxChans, const HISSTools_Wavelet *wavelet) :
+	HISSTools_OLA(calcFFTSize(maxFrameSize), maxChans), HISSTools_MultiTaper_Shrink(calcFFTSize(maxFrameSize), wavelet), HISSTools_Windows(calcFFTSize(maxFrameSize))
+	{
+		mMaxFFTSize = calcFFTSize(maxFrameSize);
+		mNChans = std::max(1UL, std::min(256UL, maxChans));
+		
+		mSpectrum = new HISSTools_FSpectrum(mMaxFFTSize, kSpectrumComplex);
+		mEstimate = new HISSTools_PSpectrum(mMaxFFTSize, kSpectrumNyquist);
+		mSynthesis = new double[mMaxFFTSize];
+		
+		for (unsigned long i = 0; i < mNChans; i++)
+		{
+			mPower[i] = new double[(mMaxFFTSize >> 1) + 1];
+			mNoise[i] = new double[(mMaxFFTSize >> 1) + 1];
+		}
+		
+		mSamplingRate = 44100.0;
+		mShrinkType = SHRINK_UNIVERSAL_SOFT;
+		mKTapers = 5;
+		mShrinkLevel = 4;
+		mAlphaUp = 0.01;
+		mAlphaDown = 0.5;
+		mLearn = TRUE;
+		mOverSubtraction = 1.0;
+		mGainFloor = 0.1;
+		mBudget = 0.0;
+		
+		resetNoise();
+		resetTimings();
+		
+		setParams(mMaxFFTSize, mMaxFFTSize >> 2, TRUE);
+	}
+	
+	~HISSTools_Spectral_Denoiser()
+	{
+		// Stop any pipelined processing before the buffers are deleted
+		
+		stopPipeline();
+		
+		delete mSpectrum;
+		delete mEstimate;
+		delete[] mSynthesis;
+		
+		for (unsigned long i = 0; i < mNChans; i++)
+		{
+			delete[] mPower[i];
+			delete[] mNoise[i];
+		}
+	}
+
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+	
+	
+	static unsigned long calcFFTSize(unsigned long frameSize)
+	{
+		unsigned long FFTSize = 4;
+		
+		while (FFTSize < frameSize)
+			FFTSize <<= 1;
+		
+		return FFTSize;
+	}
+	
+	
+	void stageTime(DenoiserStage stage, Clock::time_point &time)
+	{
+		Clock::time_point now = Clock::now();
+		
+		mStageTimes[stage] += std::chrono::duration<double>(now - time).count();
+		mHopTime += std::chrono::duration<double>(now - time).count();
+		time = now;
+	}
+
+
+protected:
+
+	void process(double *ioFrame, unsigned long frameSize)
+	{
+		process(&ioFrame, frameSize, 1UL);
+	}
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		FFT_SPLIT_COMPLEX_D FFTData = *mSpectrum->getSpectrum();
+		
+		unsigned long FFTSize = calcFFTSize(frameSize);
+		unsigned long maxBin = (FFTSize >> 1) + 1;
+		unsigned long hopSize = std::min(getHopSize(), frameSize >> 1);
+		unsigned long shrinkLevel = mDegraded == TRUE ? 0 : mShrinkLevel;
+		unsigned long i, j;
+		
+		// Sanity check
+		
+		if (FFTSize > mMaxFFTSize || !hopSize)
+			return;
+		
+		nChans = std::min(nChans, mNChans);
+		
+		Clock::time_point time = Clock::now();
+		mHopTime = 0.0;
+		
+		// Estimate (shrunk multitaper power spectrum per channel)
+		
+		for (i = 0; i < nChans; i++)
+		{
+			double *power = mPower[i];
+			
+			if (calcPowerSpectrum(ioFrames[i], mEstimate, mShrinkType, mKTapers, shrinkLevel, frameSize, FFTSize, 0.0, mSamplingRate) == FALSE)
+				return;
+			
+			double *estimate = mEstimate->getSpectrum();
+			
+			for (j = 0; j < maxBin; j++)
+				power[j] = estimate[j];
+		}
+		
+		stageTime(kDenoiseEstimate, time);
+		
+		// Noise profile (asymmetric smoothing of the estimate, starting from a copy of the first frame)
+		
+		if (mLearn == TRUE)
+		{
+			for (i = 0; i < nChans; i++)
+			{
+				double *power = mPower[i];
+				double *noise = mNoise[i];
+				
+				if (mNoiseFrames[i] && mNoiseSize[i] == FFTSize)
+				{
+					for (j = 0; j < maxBin; j++)
+						noise[j] += (power[j] > noise[j] ? mAlphaUp : mAlphaDown) * (power[j] - noise[j]);
+				}
+				else
+				{
+					for (j = 0; j < maxBin; j++)
+						noise[j] = power[j];
+				}
+				
+				mNoiseFrames[i]++;
+				mNoiseSize[i] = FFTSize;
+			}
+		}
+		
+		stageTime(kDenoiseNoise, time);
+		
+		// Wiener-style gains (calculated in place of the power estimate)
+		
+		for (i = 0; i < nChans; i++)
+		{
+			double *gains = mPower[i];
+			double *noise = mNoise[i];
+			
+			if (mNoiseSize[i] != FFTSize)
+			{
+				for (j = 0; j < maxBin; j++)
+					gains[j] = 1.0;
+				continue;
+			}
+			
+			for (j = 0; j < maxBin; j++)
+			{
+				double gain = gains[j] > 0.0 ? 1.0 - (mOverSubtraction * noise[j] / gains[j]) : 0.0;
+				gains[j] = gain > mGainFloor ? gain : mGainFloor;
+			}
+		}
+		
+		stageTime(kDenoiseGain, time);
+		
+		// Apply gains and resynthesise (the sqrt Hann windows overlap-add to frameSize / (2 * hopSize))
+		
+		for (i = 0; i < nChans; i++)
+		{
+			double *gains = mPower[i];
+			double *io = ioFrames[i];
+			
+			applyWindow(io, WIND_VON_HANN, frameSize, TRUE, 1.0, WIND_NO_GAIN);
+			
+			if (timeToSpectrum(io, mSpectrum, frameSize, FFTSize, mSamplingRate) == FALSE)
+				return;
+			
+			// DC and Nyquist have no mirror image (so their gains are applied once)
+			
+			FFTData.realp[0] *= gains[0];
+			FFTData.imagp[0] *= gains[0];
+			FFTData.realp[FFTSize >> 1] *= gains[FFTSize >> 1];
+			FFTData.imagp[FFTSize >> 1] *= gains[FFTSize >> 1];
+			
+			for (j = 1; j < (FFTSize >> 1); j++)
+			{
+				FFTData.realp[j] *= gains[j];
+				FFTData.imagp[j] *= gains[j];
+				FFTData.realp[FFTSize - j] *= gains[j];
+				FFTData.imagp[FFTSize - j] *= gains[j];
+			}
+			
+			if (spectrumToTime(mSynthesis, mSpectrum) == FALSE)
+				return;
+			
+			applyWindow(mSynthesis, io, WIND_VON_HANN, frameSize, TRUE, (2.0 * hopSize) / frameSize, WIND_NO_GAIN);
+		}
+		
+		stageTime(kDenoiseSynthesis, time);
+		
+		// Check the budget (degrading to the plain multitaper estimate when over, and restoring once comfortably under)
+		
+		mHops++;
+		
+		if (mBudget && mHopTime > mBudget)
+		{
+			mOverruns++;
+			mDegraded = TRUE;
+		}
+		else if (!mBudget || mHopTime < 0.75 * mBudget)
+			mDegraded = FALSE;
+	}
+
+
+public:
+
+	void setSamplingRate(double samplingRate)
+	{
+		mSamplingRate = samplingRate > 0.0 ? samplingRate : 44100.0;
+	}
+	
+	void setWavelet(const HISSTools_Wavelet *wavelet)
+	{
+		HISSTools_MultiTaper_Shrink::setWavelet(wavelet);
+	}
+	
+	void setEstimate(long kTapers, unsigned long shrinkLevel, ShrinkTypes shrinkType = SHRINK_UNIVERSAL_SOFT)
+	{
+		mKTapers = kTapers < 1 ? 1 : kTapers;
+		mShrinkLevel = shrinkLevel;
+		mShrinkType = shrinkType;
+	}
+	
+	void setNoiseTracking(double alphaUp, double alphaDown)
+	{
+		// Smoothing coefficients (0 - 1) for rising and falling estimates (as frame_stats_alpha() in HIRT_Frame_Stats)
+		
+		mAlphaUp = std::max(0.0, std::min(1.0, alphaUp));
+		mAlphaDown = std::max(0.0, std::min(1.0, alphaDown));
+	}
+	
+	void setLearn(bool learn)
+	{
+		// When learning is off the noise profile is frozen
+		
+		mLearn = learn;
+	}
+	
+	void setReduction(double overSubtraction, double floorDB)
+	{
+		mOverSubtraction = std::max(0.0, overSubtraction);
+		mGainFloor = std::min(1.0, pow(10.0, floorDB / 20.0));
+	}
+	
+	void resetNoise()
+	{
+		for (unsigned long i = 0; i < mNChans; i++)
+		{
+			mNoiseFrames[i] = 0;
+			mNoiseSize[i] = 0;
+		}
+	}
+	
+	const double *getNoise(unsigned long chan)
+	{
+		// Noise profile for a channel (FFTSize / 2 + 1 bins)
+		
+		return chan < mNChans ? mNoise[chan] : NULL;
+	}
+	
+	// Timing
+	
+	void setBudget(double seconds)
+	{
+		// Maximum processing time per hop (zero for no budget)
+		
+		mBudget = std::max(0.0, seconds);
+		mDegraded = FALSE;
+	}
+	
+	void resetTimings()
+	{
+		for (unsigned long i = 0; i < kDenoiseNumStages; i++)
+			mStageTimes[i] = 0.0;
+		
+		mHopTime = 0.0;
+		mHops = 0;
+		mOverruns = 0;
+		mDegraded = FALSE;
+	}
+	
+	double getStageTime(DenoiserStage stage)
+	{
+		// Mean time per hop (in seconds) spent in a stage since the last reset
+		
+		return (mHops && stage < kDenoiseNumStages) ? mStageTimes[stage] / mHops : 0.0;
+	}
+	
+	double getHopTime()
+	{
+		// Time taken by the most recent hop
+		
+		return mHopTime;
+	}
+	
+	unsigned long long getOverruns()
+	{
+		return mOverruns;
+	}
+
+
+private:
+
+	// Spectra and Buffers
+	
+	HISSTools_FSpectrum *mSpectrum;
+	HISSTools_PSpectrum *mEstimate;
+	double *mSynthesis;
+	double *mPower[256];
+	
+	// Noise Profile
+	
+	double *mNoise[256];
+	unsigned long long mNoiseFrames[256];
+	unsigned long mNoiseSize[256];
+	
+	// Parameters
+	
+	double mSamplingRate;
+	ShrinkTypes mShrinkType;
+	long mKTapers;
+	unsigned long mShrinkLevel;
+	double mAlphaUp;
+	double mAlphaDown;
+	bool mLearn;
+	double mOverSubtraction;
+	double mGainFloor;
+	
+	// Timing
+	
+	double mStageTimes[kDenoiseNumStages];
+	double mHopTime;
+	double mBudget;
+	unsigned long long mHops;
+	unsigned long long mOverruns;
+	bool mDegraded;
+	
+	// Maximums
+	
+	unsigned long mMaxFFTSize;
+	unsigned long mNChans;
+};
+
+
+#endif
@@ -4,6 +4,7 @@
 #define __HISSTOOLS_SPECTRAL_PEAKS__
 
 
+#include <atomic>
 #include "HISSTools_PSpectrum.hpp"
 
 
@@ -18,6 +19,49 @@ struct FFTPeak {
 };
 
 
+// Descriptors that can be calculated alongside peak detection (combine as flags)
+
+enum SpectralDescriptorFlags {
+	
+	kDescriptorCentroid = 0x01,
+	kDescriptorFlatness = 0x02,
+	kDescriptorFlux = 0x04,
+	kDescriptorRolloff = 0x08,
+	kDescriptorCrest = 0x10,
+	kDescriptorAll = 0x1F,
+};
+
+
+// Frequencies are normalised (bin / FFTSize) as for peakFreq - descriptors that are not requested are set to zero
+
+struct SpectralDescriptors {
+	
+	double centroid;
+	double flatness;
+	double flux;
+	double rolloff;
+	double crest;
+	
+};
+
+
+// Peaks for one frame stored as separate arrays (startBins holds nPeaks + 1 entries, the last being the end bin of the final peak)
+
+struct SpectralPeakFrame {
+
+	unsigned long *startBins;
+	unsigned long *peakBins;
+	
+	double *peakFreqs;
+	double *peakAmps;
+	
+	unsigned long nPeaks;
+	unsigned long FFTSize;
+	unsigned long long frame;
+
+};
+
+
 class HISSTools_Spectral_Peaks
 {
 	
@@ -26,22 +70,80 @@ public:
 	HISSTools_Spectral_Peaks(long maxFFTSize) 
 	{
 		maxFFTSize = maxFFTSize < 8 ? 1 : maxFFTSize;		
-		mPeakData = new FFTPeak[(maxFFTSize >> 1) / 3 + 1];
+		mMaxPeaks = (maxFFTSize >> 1) / 3 + 1;
+		mPrevSpectrum = new double[(maxFFTSize >> 1) + 1];
+		mMaxFFTSize = maxFFTSize;
 
-		if (mPeakData)
-			mMaxFFTSize = maxFFTSize;
+		allocFrame(&mScratch);
 		
-		mNPeaks = 0;
-		mFFTSize = 0;
+		mSlots = NULL;
+		mNSlots = 0;
+		mRead = 0;
+		mWrite = 0;
+		mDropped = 0;
+		mFrameCount = 0;
+		mCurrent = &mScratch;
+		mPrevFFTSize = 0;
 	};
 	
 	~HISSTools_Spectral_Peaks() 
 	{
-		delete[] mPeakData;
+		setExportSlots(0);
+		freeFrame(&mScratch);
+		delete[] mPrevSpectrum;
 	};
 	
 	
 private:
+
+	void allocFrame(SpectralPeakFrame *frame)
+	{
+		frame->startBins = new unsigned long[mMaxPeaks + 1];
+		frame->peakBins = new unsigned long[mMaxPeaks];
+		frame->peakFreqs = new double[mMaxPeaks];
+		frame->peakAmps = new double[mMaxPeaks];
+		frame->startBins[0] = 0;
+		frame->nPeaks = 0;
+		frame->FFTSize = 0;
+		frame->frame = 0;
+	}
+	
+	
+	void freeFrame(SpectralPeakFrame *frame)
+	{
+		delete[] frame->startBins;
+		delete[] frame->peakBins;
+		delete[] frame->peakFreqs;
+		delete[] frame->peakAmps;
+	}
+	
+	
+	SpectralPeakFrame *getWriteFrame()
+	{
+		// Write directly into the next free export slot (or the private frame if there is no export or the ring is full)
+		
+		if (!mNSlots)
+			return &mScratch;
+		
+		unsigned long write = mWrite.load(std::memory_order_relaxed);
+		
+		if ((write + 1) % (mNSlots + 1) == mRead.load(std::memory_order_acquire))
+		{
+			mDropped++;
+			return &mScratch;
+		}
+		
+		return mSlots + write;
+	}
+	
+	
+	void publishFrame(SpectralPeakFrame *frame)
+	{
+		mCurrent = frame;
+		
+		if (frame != &mScratch)
+			mWrite.store((mWrite.load(std::memory_order_relaxed) + 1) % (mNSlots + 1), std::memory_order_release);
+	}
 	
 	unsigned long clipReadBin(unsigned long readBin, unsigned long FFTSize, PSpectrumFormat format)
 	{
@@ -63,10 +165,12 @@ private:
 		return 0;
 	}
 	
+public:
+	
 	
-	double interpolatePeak(double a, double b, double c, long peakBin, long FFTSize, double *peakAmp)
+	static double interpolatePeak(double a, double b, double c, long peakBin, long FFTSize, double *peakAmp)
 	{				
-		// Peak interpolation (amplitude and bin location)
+		// Parabolic peak interpolation (amplitude and bin location) - also valid for minima, and shared with other estimators
 		
 		double d = a + c - (2.0 * b);
 		double p = d ? (0.5 * (a - c)) / d: 0;
@@ -75,76 +179,173 @@ private:
 		return (peakBin + p) / FFTSize;
 	}
 	
-public:
-	
 	
 	unsigned long getFFTSize()
 	{
-		return mFFTSize;
+		return mCurrent->FFTSize;
 	}
 	
 	
 	unsigned long getStartBin (long peak)
 	{
-		return mPeakData[peak].startBin;
+		return mCurrent->startBins[peak];
 	}
 	
 	
 	unsigned long getEndBin (unsigned long peak)
 	{
-		if (peak < mNPeaks - 1)
-			return mPeakData[peak + 1].startBin;
-		
-		return HISSTools_PSpectrum::calcMaxBin(mFFTSize, kSpectrumNyquist);
+		return mCurrent->startBins[peak + 1];
 	}
 	
 	
 	unsigned long getPeakBin (unsigned long peak)
 	{
-		return mPeakData[peak].peakBin;
+		return mCurrent->peakBins[peak];
 	}
 	
 	
 	double getPeakFreq (unsigned long peak)
 	{
-		return mPeakData[peak].peakFreq;
+		return mCurrent->peakFreqs[peak];
 	}
 	
 	
 	double getPeakAmp (unsigned long peak)
 	{
-		return mPeakData[peak].peakAmp;
+		return mCurrent->peakAmps[peak];
+	}
+	
+	
+	FFTPeak getPeak (unsigned long peak)
+	{
+		FFTPeak peakData;
+		
+		peakData.startBin = mCurrent->startBins[peak];
+		peakData.peakBin = mCurrent->peakBins[peak];
+		peakData.peakFreq = mCurrent->peakFreqs[peak];
+		peakData.peakAmp = mCurrent->peakAmps[peak];
+		
+		return peakData;
 	}
 	
 	
 	unsigned long getNPeaks ()
 	{
-		return mNPeaks;
+		return mCurrent->nPeaks;
+	}
+	
+	
+	const SpectralPeakFrame *getPeakFrame ()
+	{
+		// Arrays for the most recent frame (valid until the next call to findPeaks)
+		
+		return mCurrent;
+	}
+	
+	
+	// Export
+	
+	void setExportSlots(unsigned long nSlots)
+	{
+		// Each frame of peaks is written straight into a slot of a single producer / single consumer ring (zero for no export)
+		// Frames found whilst the ring is full are not exported (see getDroppedFrames())
+		// N.B. this allocates memory and is not threadsafe
+		
+		for (unsigned long i = 0; i < mNSlots + 1 && mSlots; i++)
+			freeFrame(mSlots + i);
+		
+		delete[] mSlots;
+		mSlots = NULL;
+		mNSlots = nSlots;
+		mRead = 0;
+		mWrite = 0;
+		mCurrent = &mScratch;
+		
+		if (!nSlots)
+			return;
+		
+		mSlots = new SpectralPeakFrame[nSlots + 1];
+		
+		for (unsigned long i = 0; i < nSlots + 1; i++)
+			allocFrame(mSlots + i);
+	}
+	
+	
+	const SpectralPeakFrame *acquireFrame()
+	{
+		// Consumer side - returns the oldest exported frame (or NULL if there are none), which remains valid until releaseFrame()
+		
+		unsigned long read = mRead.load(std::memory_order_relaxed);
+		
+		if (!mNSlots || read == mWrite.load(std::memory_order_acquire))
+			return NULL;
+		
+		return mSlots + read;
+	}
+	
+	
+	void releaseFrame()
+	{
+		unsigned long read = mRead.load(std::memory_order_relaxed);
+		
+		if (mNSlots && read != mWrite.load(std::memory_order_acquire))
+			mRead.store((read + 1) % (mNSlots + 1), std::memory_order_release);
+	}
+	
+	
+	unsigned long long getDroppedFrames()
+	{
+		return mDropped;
 	}
 	
 	
 	bool findPeaks (HISSTools_PSpectrum *inSpectrum)
-	{		
+	{
+		return findPeaks(inSpectrum, NULL, 0);
+	}
+	
+	
+	bool findPeaks (HISSTools_PSpectrum *inSpectrum, SpectralDescriptors *descriptors, unsigned long descriptorFlags, double rolloffPoint = 0.95)
+	{
 		PSpectrumFormat format = inSpectrum->getFormat();
-		FFTPeak *peakData = mPeakData;
+		SpectralPeakFrame *peakFrame;
 		
 		double *spectrum = inSpectrum->getSpectrum();
+		double *prevSpectrum = mPrevSpectrum;
 		double v1, v2, v3, v4, v5;
 		double peakFreq, peakAmp;
 		double minVal = HUGE_VAL;
 		
+		double sum = 0.0;
+		double weightedSum = 0.0;
+		double logSum = 0.0;
+		double flux = 0.0;
+		double maxVal = 0.0;
+		
 		unsigned long FFTSize = inSpectrum->getFFTSize();
 		unsigned long highestBin = HISSTools_PSpectrum::calcMaxBin(FFTSize, kSpectrumNyquist);
 		unsigned long readBin;
 		unsigned long minBin = 0;
 		unsigned long NPeaks = 0;
+		unsigned long skipBins = 0;
 		unsigned long i;
-
+		
+		bool calcFlatness = descriptors && (descriptorFlags & kDescriptorFlatness);
+		bool calcFlux = descriptors && (descriptorFlags & kDescriptorFlux) && (mPrevFFTSize == FFTSize);
+		bool storeSpectrum = descriptors && (descriptorFlags & (kDescriptorFlux | kDescriptorRolloff));
+		
 		// Sanity Check
 		
 		if (FFTSize > mMaxFFTSize)
 			return FALSE;
 		
+		peakFrame = getWriteFrame();
+		
+		unsigned long *startBins = peakFrame->startBins;
+		unsigned long *peakBins = peakFrame->peakBins;
+		double *peakFreqs = peakFrame->peakFreqs;
+		double *peakAmps = peakFrame->peakAmps;
+		
 		// Initialise peak array
 		
 		v2 = spectrum[2];
@@ -152,7 +353,7 @@ public:
 		v4 = spectrum[0];
 		v5 = spectrum[1];
 		
-		// Loop over spectrum to find peaks
+		// Loop over spectrum to find peaks (and accumulate descriptors for the current bin in the same pass)
 		
 		for (i = 0; i < highestBin; i++)
 		{
@@ -164,22 +365,49 @@ public:
 			v4 = v5;
 			v5 = spectrum[readBin];
 			
+			if (descriptors)
+			{
+				sum += v3;
+				weightedSum += v3 * i;
+				maxVal = v3 > maxVal ? v3 : maxVal;
+				
+				if (calcFlatness)
+					logSum += log(v3 > 1e-300 ? v3 : 1e-300);
+				
+				if (calcFlux)
+				{
+					double difference = v3 - prevSpectrum[i];
+					flux += difference > 0.0 ? difference : 0.0;
+				}
+				
+				if (storeSpectrum)
+					prevSpectrum[i] = v3;
+			}
+			
+			// The two bins after a peak cannot by definition be peaks
+			
+			if (skipBins)
+			{
+				skipBins--;
+				continue;
+			}
+			
 			if (v3 > v2 && v3 > v1 && v3 > v4 && v3 > v5)
 			{
-				// We have new peak - can skip two bins (which cannot by defintion by peaks)
+				// We have new peak
 				
 				peakFreq = interpolatePeak(v2, v3, v4, i, FFTSize, &peakAmp);
 				
-				peakData[NPeaks].startBin = minBin;
-				peakData[NPeaks].peakBin = i;
-				peakData[NPeaks].peakFreq = peakFreq;
-				peakData[NPeaks].peakAmp = peakAmp;
+				startBins[NPeaks] = minBin;
+				peakBins[NPeaks] = i;
+				peakFreqs[NPeaks] = peakFreq;
+				peakAmps[NPeaks] = peakAmp;
 				
 				minVal = v4 < v5 ? v4 : v5;
 				minBin = v4 < v5 ? i + 1 : i + 2;
 				
 				NPeaks++;
-				i += 2;
+				skipBins = 2;
 			}
 			else 
 			{
@@ -191,29 +419,91 @@ public:
 					minBin = i;
 				}
 			}
-
+			
+		}
+		
+		startBins[NPeaks] = highestBin;
+		
+		peakFrame->nPeaks = NPeaks;
+		peakFrame->FFTSize = FFTSize;
+		peakFrame->frame = mFrameCount++;
+		
+		publishFrame(peakFrame);
+		
+		// Finalise descriptors
+		
+		if (descriptors)
+		{
+			double mean = sum / highestBin;
+			
+			descriptors->centroid = (sum > 0.0 && (descriptorFlags & kDescriptorCentroid)) ? (weightedSum / sum) / FFTSize : 0.0;
+			descriptors->flatness = (sum > 0.0 && calcFlatness) ? exp(logSum / highestBin) / mean : 0.0;
+			descriptors->flux = flux;
+			descriptors->crest = (sum > 0.0 && (descriptorFlags & kDescriptorCrest)) ? maxVal / mean : 0.0;
+			descriptors->rolloff = 0.0;
+			
+			// Rolloff scans down from the top of the stored (cache-resident) copy of the spectrum
+			
+			if (sum > 0.0 && (descriptorFlags & kDescriptorRolloff))
+			{
+				double remain = sum;
+				double target = sum * (rolloffPoint < 1.0 ? rolloffPoint : 1.0);
+				
+				for (i = highestBin; i > 1; i--)
+				{
+					remain -= prevSpectrum[i - 1];
+					
+					if (remain < target)
+						break;
+				}
+				
+				descriptors->rolloff = (double) (i - 1) / FFTSize;
+			}
 		}
 		
-		mNPeaks = NPeaks;
-		mFFTSize = FFTSize;
+		// The previous spectrum is only valid for flux if it was stored from this frame
+		
+		if (storeSpectrum)
+			mPrevFFTSize = FFTSize;
+		else
+			resetDescriptors();
 		
 		return TRUE;
 	}
 	
+	
+	void resetDescriptors()
+	{
+		// Forget the previous frame used for spectral flux
+		
+		mPrevFFTSize = 0;
+	}
+	
 private:
 	
 	// Data
 	
-	FFTPeak *mPeakData;
+	SpectralPeakFrame mScratch;
+	SpectralPeakFrame *mCurrent;
+	double *mPrevSpectrum;
+	
+	// Export Ring
+	
+	SpectralPeakFrame *mSlots;
+	unsigned long mNSlots;
+	std::atomic<unsigned long> mRead;
+	std::atomic<unsigned long> mWrite;
+	unsigned long long mDropped;
+	unsigned long long mFrameCount;
 		
 	// Current Parameters
 	
-	unsigned long mFFTSize;
-	unsigned long mNPeaks;
+	unsigned long mPrevFFTSize;
 	
-	// Maximum FFT Size
+	// Maximums
 	
 	unsigned long mMaxFFTSize;
+	unsigned long mMaxPeaks;
 	
 };
 
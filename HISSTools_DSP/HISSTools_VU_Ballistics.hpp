@@ -2,6 +2,8 @@
 #ifndef __HISSTOOLS_VU_BALLISTICS__
 #define __HISSTOOLS_VU_BALLISTICS__
 
+#include "../HISSTools_Utility/HISSTools_State.hpp"
+
 const double METER_ATTACK = 0.8, METER_DECAY = 0.12, RMS_TIME_CONST = 0.1, PEAK_HOLD_SAMPLES = 22050;  
 const double LED_ATTACK = 1.0, LED_DECAY = 0.4;  
 
@@ -13,6 +15,8 @@ private:
 	
 	int mNumChans;
 	
+	static const uint32_t kStateVersion = 1;
+	
 	double mPeakHoldTime;
 	
 	// Previous Values
@@ -135,6 +139,57 @@ public:
 		
 		return 6;		
 	}
+	
+	// State
+	
+	unsigned long getStateSize()
+	{
+		HISSTools_StateWriter writer;
+		writeState(writer);
+		return writer.getPosition();
+	}
+	
+	bool saveState(void *data, unsigned long size)
+	{
+		HISSTools_StateWriter writer(data, size);
+		writeState(writer);
+		return writer.isValid();
+	}
+	
+	bool restoreState(const void *data, unsigned long size)
+	{
+		HISSTools_StateReader reader(data, size);
+		return readState(reader);
+	}
+	
+	void writeState(HISSTools_StateWriter& writer)
+	{
+		unsigned long position = writer.beginState(kStateTagVU, kStateVersion);
+		
+		writer.write(mPeakHoldTime);
+		writer.write(mLastPeak);
+		writer.write(mLastRMS);
+		writer.write(mLastPeakHold);
+		writer.write(mPeaks, 256);
+		writer.write(mPeakHolds, 256);
+		
+		writer.endState(position);
+	}
+	
+	bool readState(HISSTools_StateReader& reader)
+	{
+		if (reader.beginState(kStateTagVU, kStateVersion, getStateSize()) == FALSE)
+			return FALSE;
+		
+		reader.read(mPeakHoldTime);
+		reader.read(mLastPeak);
+		reader.read(mLastRMS);
+		reader.read(mLastPeakHold);
+		reader.read(mPeaks, 256);
+		reader.read(mPeakHolds, 256);
+		
+		return reader.isValid();
+	}
 };
 
 #endif /* __HISSTOOLS_VU_BALLISTICS__ */
\ No newline at end of file
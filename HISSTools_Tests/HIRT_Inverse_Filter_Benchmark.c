@@ -0,0 +1,108 @@
+
+// Benchmarks inverse_filter_calc() for square MIMO systems at a 64k FFT size
+//
+// Usage: HIRT_Inverse_Filter_Benchmark [size ...] (the default sizes are 8, 16 and 32 - a 32 x 32 system needs around 600MB)
+// The responses are synthetic (decaying noise plus a direct path on the diagonal) with flat regularisation at -60dB
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "HIRT_Inverse_Filter.h"
+#include <AH_Threads.h>
+
+
+static double benchmark_time(void)
+{
+	struct timespec now;
+	
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+
+static void benchmark_size(AH_UIntPtr size, AH_UIntPtr fft_size_log2, AH_UIntPtr ir_length, AH_UIntPtr max_threads)
+{
+	double reg_curve[4] = {20., -60., 20000., -60.};
+	double **irs = (double **) malloc(sizeof(double *) * size * size);
+	double **filters = (double **) malloc(sizeof(double *) * size * size);
+	double start, end;
+	
+	AH_UIntPtr fft_size = (AH_UIntPtr) 1 << fft_size_log2;
+	AH_UIntPtr i, j;
+	
+	t_inverse_filter_params params;
+	
+	long failed_bins = -1;
+	
+	params.num_outs = size;
+	params.num_ins = size;
+	params.fft_size_log2 = fft_size_log2;
+	params.sample_rate = 48000.;
+	params.delay = (double) (fft_size >> 1);
+	params.reg_curve = reg_curve;
+	params.reg_num_points = 2;
+	params.max_threads = max_threads;
+	
+	srand(1);
+	
+	for (i = 0; irs && filters && i < size * size; i++)
+	{
+		irs[i] = (double *) malloc(sizeof(double) * ir_length);
+		filters[i] = (double *) malloc(sizeof(double) * fft_size);
+		
+		if (!irs[i] || !filters[i])
+		{
+			printf("%4lu x %-4lu allocation failed\n", (unsigned long) size, (unsigned long) size);
+			return;
+		}
+		
+		for (j = 0; j < ir_length; j++)
+			irs[i][j] = (rand() / (double) RAND_MAX - 0.5) * exp(-(double) j / 20.);
+		
+		if (i / size == i % size)
+			irs[i][0] += 1.;
+	}
+	
+	if (irs && filters)
+	{
+		start = benchmark_time();
+		failed_bins = inverse_filter_calc(filters, irs, ir_length, &params);
+		end = benchmark_time();
+		
+		printf("%4lu x %-4lu threads %-3lu %8.3f s (%.2f us per bin)  failed bins %ld\n", (unsigned long) size, (unsigned long) size, (unsigned long) max_threads, end - start, (end - start) * 1e6 / (fft_size >> 1), failed_bins);
+	}
+	
+	for (i = 0; irs && filters && i < size * size; i++)
+	{
+		free(irs[i]);
+		free(filters[i]);
+	}
+	
+	free(irs);
+	free(filters);
+}
+
+
+int main(int argc, char **argv)
+{
+	AH_UIntPtr default_sizes[3] = {8, 16, 32};
+	AH_UIntPtr num_processors = ah_num_processors();
+	int i;
+	
+	printf("FFT size 65536, responses of 1024 samples, processors available: %lu\n\n", (unsigned long) num_processors);
+	
+	for (i = 0; i < (argc > 1 ? argc - 1 : 3); i++)
+	{
+		AH_UIntPtr size = argc > 1 ? (AH_UIntPtr) strtoul(argv[i + 1], NULL, 10) : default_sizes[i];
+		
+		benchmark_size(size, 16, 1024, 1);
+		
+		if (num_processors > 1)
+			benchmark_size(size, 16, 1024, num_processors);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,130 @@
+
+// Benchmarks the sparse spectral kernel constant-Q transform against a naive (direct time-domain) constant-Q transform
+//
+// The naive transform takes the inner product of the frame with each Hann windowed complex exponential kernel
+// Reports the kernel density, the worst error relative to the largest coefficient and the time per frame of each method
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Constant_Q.hpp"
+
+
+class Store_Constant_Q : public HISSTools_Constant_Q
+{
+	
+public:
+	
+	Store_Constant_Q() : HISSTools_Constant_Q(32768), mNFrames(0) {}
+	
+	std::vector<double> mReal;
+	std::vector<double> mImag;
+	unsigned long mNFrames;
+	
+protected:
+	
+	void processCQ(const double *real, const double *imag, unsigned long nBins)
+	{
+		mReal.assign(real, real + nBins);
+		mImag.assign(imag, imag + nBins);
+		mNFrames++;
+	}
+};
+
+
+static void naiveConstantQ(const double *frame, unsigned long FFTSize, Store_Constant_Q& cq, double samplingRate, unsigned long binsPerOctave, double gamma, std::vector<double>& real, std::vector<double>& imag)
+{
+	// Kernels are centred in the frame with the phase referenced to the frame centre (as for the sparse kernels)
+	
+	double alpha = pow(2.0, 1.0 / binsPerOctave) - 1.0;
+	
+	real.resize(cq.getNBins());
+	imag.resize(cq.getNBins());
+	
+	for (unsigned long i = 0; i < cq.getNBins(); i++)
+	{
+		double frequency = cq.getFrequency(i);
+		double length = samplingRate / (alpha * frequency + gamma);
+		double start = (FFTSize - length) * 0.5;
+		
+		real[i] = 0.0;
+		imag[i] = 0.0;
+		
+		for (unsigned long j = (unsigned long) std::max(0.0, ceil(start)); j < FFTSize && j < start + length; j++)
+		{
+			double window = (0.5 - 0.5 * cos(2.0 * M_PI * (j - start) / length)) / length;
+			double phase = 2.0 * M_PI * frequency * ((double) j - (double) (FFTSize >> 1)) / samplingRate;
+			
+			real[i] += frame[j] * window * cos(phase);
+			imag[i] -= frame[j] * window * sin(phase);
+		}
+	}
+}
+
+
+static bool benchmark(double gamma)
+{
+	const double samplingRate = 44100.0;
+	const unsigned long binsPerOctave = 24;
+	
+	Store_Constant_Q cq, timed;
+	
+	std::vector<double> input, naiveReal, naiveImag;
+	
+	cq.setKernel(55.0, 7040.0, binsPerOctave, samplingRate, gamma);
+	timed.setKernel(55.0, 7040.0, binsPerOctave, samplingRate, gamma);
+	
+	unsigned long FFTSize = cq.getFFTSize();
+	unsigned long nBins = cq.getNBins();
+	
+	input.resize(FFTSize * 8);
+	
+	srand(1);
+	
+	for (unsigned long i = 0; i < input.size(); i++)
+		input[i] = sin(2.0 * M_PI * 440.0 * i / samplingRate) + 0.5 * sin(2.0 * M_PI * 110.3 * i / samplingRate) + 0.01 * (rand() / (double) RAND_MAX - 0.5);
+	
+	// Accuracy (the last frame of two frame lengths of input)
+	
+	cq.setHopSize(512);
+	cq.streamToFrame(input.data(), FFTSize * 2);
+	
+	const double *frame = input.data() + (unsigned long) cq.getFrameHostTime() + 1 - FFTSize;
+	
+	HISSTools_Test_Timer naiveTimer;
+	naiveConstantQ(frame, FFTSize, cq, samplingRate, binsPerOctave, gamma, naiveReal, naiveImag);
+	double naiveTime = naiveTimer.elapsed();
+	
+	double maxError = 0.0;
+	double maxMagnitude = 0.0;
+	
+	for (unsigned long i = 0; i < nBins; i++)
+	{
+		maxError = std::max(maxError, hypot(naiveReal[i] - cq.mReal[i], naiveImag[i] - cq.mImag[i]));
+		maxMagnitude = std::max(maxMagnitude, hypot(naiveReal[i], naiveImag[i]));
+	}
+	
+	// Speed (FFT plus sparse product per frame)
+	
+	timed.setHopSize(FFTSize);
+	
+	HISSTools_Test_Timer sparseTimer;
+	timed.streamToFrame(input.data(), input.size());
+	double sparseTime = sparseTimer.elapsed() / std::max(1UL, timed.mNFrames);
+	
+	printf("gamma %4.1f  %lu bins  FFT %lu  kernel %lu values (%.1f%% of dense)\n", gamma, nBins, FFTSize, timed.getKernelSize(), 100.0 * timed.getKernelSize() / (nBins * ((FFTSize >> 1) + 1)));
+	printf("            relative error %.1e  sparse %.3f ms per frame  naive %.3f ms per frame  (x%.1f)\n\n", maxError / maxMagnitude, sparseTime * 1e3, naiveTime * 1e3, naiveTime / sparseTime);
+	
+	return maxError / maxMagnitude < 1e-2;
+}
+
+
+int main()
+{
+	bool success = TRUE;
+	
+	printf("55Hz to 7040Hz at 24 bins per octave (44.1kHz)\n\n");
+	
+	success &= benchmark(0.0);
+	success &= benchmark(20.0);
+	
+	return success ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+
+// Benchmarks the storage modes of HISSTools_Frame_Delay
+//
+// Reports the memory used, the worst relative error of values read back and the encode + decode throughput of delayIO()
+// The frames span a wide dynamic range (as power spectra do), so the saturation of half precision shows in its error
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Frame_Delay.hpp"
+
+
+int main()
+{
+	const unsigned long frameSize = 4096;
+	const unsigned long nFrames = 512;
+	const unsigned long frameDelay = nFrames >> 1;
+	const unsigned long nIterations = 2000;
+	
+	const FrameDelayStorage storage[4] = {kFrameStoreDouble, kFrameStoreFloat, kFrameStoreHalf, kFrameStoreLogMagnitude};
+	const char *names[4] = {"double", "float", "half", "log magnitude"};
+	
+	std::vector<double> input(frameSize), output(frameSize);
+	
+	printf("%lu frames of %lu values (delay %lu frames)\n\n", nFrames, frameSize, frameDelay);
+	
+	for (unsigned long i = 0; i < 4; i++)
+	{
+		HISSTools_Frame_Delay delay(frameSize, nFrames, 1, storage[i]);
+		
+		double maxError = 0.0;
+		double maxHalfRangeError = 0.0;
+		double best = HUGE_VAL;
+		
+		// Accuracy (values from 1e-9 to 1e9 of both signs)
+		
+		for (unsigned long j = 0; j < frameDelay + 1; j++)
+		{
+			for (unsigned long k = 0; k < frameSize; k++)
+				input[k] = ((k & 1) ? -1.0 : 1.0) * pow(10.0, 9.0 * sin(0.001 * (k + 1) * (j + 1)));
+			
+			delay.delayIO(input.data(), output.data(), frameSize, frameDelay);
+		}
+		
+		for (unsigned long k = 0; k < frameSize; k++)
+		{
+			double expected = ((k & 1) ? -1.0 : 1.0) * pow(10.0, 9.0 * sin(0.001 * (k + 1)));
+			double error = fabs(output[k] - expected) / fabs(expected);
+			
+			maxError = std::max(maxError, error);
+			
+			if (fabs(expected) >= 1e-4 && fabs(expected) <= 6e4)
+				maxHalfRangeError = std::max(maxHalfRangeError, error);
+		}
+		
+		// Throughput (best of five runs)
+		
+		for (unsigned long j = 0; j < 5; j++)
+		{
+			HISSTools_Test_Timer timer;
+			
+			for (unsigned long k = 0; k < nIterations; k++)
+			{
+				input[0] = (double) k;
+				delay.delayIO(input.data(), output.data(), frameSize, frameDelay);
+			}
+			
+			best = std::min(best, timer.elapsed());
+		}
+		
+		printf("%-14s %4lu MB  max relative error %8.2e (1e-4 to 6e4) %8.2e (1e-9 to 1e9)  %7.1f Mvalues/s (encode + decode)\n", names[i], delay.getMemorySize() >> 20, maxHalfRangeError, maxError, nIterations * (double) frameSize / best * 1e-6);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,93 @@
+
+// Checks that fractional frames (setFractionalFrames()) are aligned exactly to the hop grid
+//
+// Sines are framed with a fractional hop and each frame is compared to the sine evaluated at the times given by getFrameHostTime()
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Frame.hpp"
+
+
+class Sine_Frame : public HISSTools_Frame
+{
+	
+public:
+	
+	Sine_Frame(unsigned long nTaps, double hopSize, double frequency) : HISSTools_Frame(512, 1), mHopSize(hopSize), mFrequency(frequency)
+	{
+		setParams(256, hopSize, TRUE);
+		setFractionalFrames(nTaps);
+		
+		mNFrames = 0;
+		mMaxError = 0.0;
+		mMaxOffset = 0.0;
+		mMaxHopError = 0.0;
+	}
+	
+	unsigned long mNFrames;
+	double mMaxError;
+	double mMaxOffset;
+	double mMaxHopError;
+	
+protected:
+	
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		// Sample k of the frame is at time end - (frameSize - 1) + k (ignore the first frames, which include the initial silence)
+		
+		double end = getFrameHostTime();
+		
+		if (mNFrames++ > 5)
+		{
+			for (unsigned long k = 0; k < frameSize; k++)
+				mMaxError = std::max(mMaxError, fabs(iFrame[k] - sin(mFrequency * (end - (frameSize - 1) + k))));
+			
+			mMaxHopError = std::max(mMaxHopError, fabs(end - mLastEnd - mHopSize));
+		}
+		
+		mMaxOffset = std::max(mMaxOffset, fabs(fractionalOffset));
+		mLastEnd = end;
+	}
+	
+private:
+	
+	double mHopSize;
+	double mFrequency;
+	double mLastEnd;
+};
+
+
+static bool testFractional(unsigned long nTaps, double frequency, double tolerance)
+{
+	Sine_Frame frame(nTaps, 100.37, frequency);
+	
+	double input[64];
+	char description[128];
+	
+	for (unsigned long block = 0; block < 200; block++)
+	{
+		for (unsigned long i = 0; i < 64; i++)
+			input[i] = sin(frequency * (block * 64 + i));
+		
+		frame.streamToFrame(input, 64);
+	}
+	
+	snprintf(description, 128, "%lu taps at %.2f rad/sample - error %.1e, hop error %.1e, offset %.1e", nTaps, frequency, frame.mMaxError, frame.mMaxHopError, frame.mMaxOffset);
+	
+	return HISSTools_Test_Check(frame.mNFrames > 100 && frame.mMaxError < tolerance && frame.mMaxHopError < 1e-9 && frame.mMaxOffset == 0.0, description);
+}
+
+
+int main()
+{
+	bool success = TRUE;
+	
+	const double frequencies[3] = {0.05, 0.5, 1.5};
+	
+	for (unsigned long i = 0; i < 3; i++)
+	{
+		success &= testFractional(32, frequencies[i], 1e-4);
+		success &= testFractional(64, frequencies[i], 5e-5);
+	}
+	
+	return success ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Checks that HISSTools_Mapped_IOStream keeps a bounded number of pages locked and keeps time across dropped blocks
+//
+// The locked memory is read from /proc/self/status (VmLck) where available, while a stream is written in small blocks paced in real time
+// Dropped blocks are forced by writing much faster than the background thread makes pages resident
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Mapped_IOStream.hpp"
+
+#include <thread>
+
+
+static long long lockedBytes()
+{
+	// Returns -1 where the locked memory cannot be read
+	
+	FILE *status = fopen("/proc/self/status", "r");
+	char line[256];
+	long long kiloBytes = -1;
+	
+	if (!status)
+		return -1;
+	
+	while (fgets(line, 256, status))
+		if (sscanf(line, "VmLck: %lld kB", &kiloBytes) == 1)
+			break;
+	
+	fclose(status);
+	
+	return kiloBytes < 0 ? -1 : kiloBytes * 1024;
+}
+
+
+static bool testLockedPages()
+{
+	// 1M stereo samples in blocks of 256 every millisecond (the background thread runs every millisecond)
+	
+	const unsigned long nChans = 2;
+	const unsigned long residentSize = 16384;
+	const unsigned long blockSize = 256;
+	const unsigned long nBlocks = 4096;
+	
+	HISSTools_Mapped_IOStream stream(1 << 22, nChans, residentSize);
+	
+	static double inputs[2][256];
+	double *ins[2] = {inputs[0], inputs[1]};
+	long long pageSize = sysconf(_SC_PAGESIZE);
+	long long bound = nChans * (2 * residentSize * sizeof(float) + 4 * pageSize);
+	long long maxLocked = lockedBytes();
+	char description[256];
+	
+	if (!stream.isValid())
+		return HISSTools_Test_Check(FALSE, "locked pages - could not create the stream");
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	for (unsigned long i = 0; i < nBlocks; i++)
+	{
+		for (unsigned long j = 0; j < blockSize; j++)
+			inputs[0][j] = inputs[1][j] = sin((i * blockSize + j) * 0.01);
+		
+		stream.write(ins, nChans, blockSize, 0);
+		
+		if ((i & 63) == 0)
+			maxLocked = std::max(maxLocked, lockedBytes());
+		
+		std::this_thread::sleep_until(start + std::chrono::milliseconds(i + 1));
+	}
+	
+	maxLocked = std::max(maxLocked, lockedBytes());
+	
+	if (maxLocked < 0)
+	{
+		printf("SKIP: locked pages - VmLck is not available (%llu underruns)\n", stream.getUnderruns());
+		return TRUE;
+	}
+	
+	snprintf(description, 256, "locked pages - at most %lld KB locked after %lu samples (bound %lld KB, %llu underruns)", maxLocked / 1024, nBlocks * blockSize, bound / 1024, stream.getUnderruns());
+	
+	return HISSTools_Test_Check(maxLocked <= bound, description);
+}
+
+
+static bool testDroppedBlocks()
+{
+	// Each sample holds its index + 1, so dropped samples (which should read as zero) can be told apart from written ones
+	
+	const unsigned long residentSize = 4096;
+	const unsigned long blockSize = 256;
+	const unsigned long nBlocks = 800;
+	
+	HISSTools_Mapped_IOStream stream(1 << 20, 1, residentSize);
+	
+	static double input[256];
+	static double output[256 * 800];
+	static bool dropped[800];
+	unsigned long nDropped = 0;
+	unsigned long nErrors = 0;
+	char description[256];
+	
+	if (!stream.isValid())
+		return HISSTools_Test_Check(FALSE, "dropped blocks - could not create the stream");
+	
+	for (unsigned long i = 0; i < nBlocks; i++)
+	{
+		for (unsigned long j = 0; j < blockSize; j++)
+			input[j] = i * blockSize + j + 1;
+		
+		dropped[i] = !stream.write(input, blockSize, 0);
+		nDropped += dropped[i];
+	}
+	
+	// Let the background thread catch up, then read back the whole stream
+	
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	
+	bool readSuccess = stream.readHistory(output, nBlocks * blockSize, 0);
+	
+	for (unsigned long i = 0; i < nBlocks; i++)
+		for (unsigned long j = 0; j < blockSize; j++)
+			if (output[i * blockSize + j] != (dropped[i] ? 0.0 : i * blockSize + j + 1))
+				nErrors++;
+	
+	snprintf(description, 256, "dropped blocks - %lu of %lu blocks dropped, %llu samples written, %lu samples out of place", nDropped, nBlocks, stream.getWritten(), nErrors);
+	
+	return HISSTools_Test_Check(nDropped > 0 && nDropped == stream.getUnderruns() && stream.getWritten() == nBlocks * blockSize && readSuccess && !nErrors, description);
+}
+
+
+int main()
+{
+	bool success = TRUE;
+	
+	success &= testLockedPages();
+	success &= testDroppedBlocks();
+	
+	return success ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+
+// Checks that the statically dispatched (CRTP) engines produce the same output as the virtual adapters
+//
+// The CRTP classes declare only the overloads they need and bring the defaults into scope with a using-declaration (as documented)
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_OLA.hpp"
+#include "HISSTools_Frame.hpp"
+
+
+// Processing shared by both forms (a position dependent gain, so that any misalignment of frames changes the output)
+
+static void shapeFrame(double *ioFrame, unsigned long frameSize)
+{
+	for (unsigned long i = 0; i < frameSize; i++)
+		ioFrame[i] *= 0.25 * sin(M_PI * (i + 0.5) / frameSize);
+}
+
+
+class Virtual_OLA : public HISSTools_OLA
+{
+	
+public:
+	
+	Virtual_OLA(unsigned long frameSize, unsigned long hopSize) : HISSTools_OLA(frameSize, 2)
+	{
+		setParams(frameSize, hopSize, TRUE);
+	}
+	
+protected:
+	
+	void process(double *ioFrame, unsigned long frameSize)
+	{
+		shapeFrame(ioFrame, frameSize);
+	}
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		for (unsigned long i = 0; i < nChans; i++)
+			shapeFrame(ioFrames[i], frameSize);
+	}
+};
+
+
+class Static_OLA : public HISSTools_OLA_Base <Static_OLA>
+{
+	
+public:
+	
+	Static_OLA(unsigned long frameSize, unsigned long hopSize) : HISSTools_OLA_Base <Static_OLA> (frameSize, 2)
+	{
+		setParams(frameSize, hopSize, TRUE);
+	}
+	
+	using HISSTools_OLA_Base <Static_OLA>::process;
+	
+	void process(double *ioFrame, unsigned long frameSize)
+	{
+		shapeFrame(ioFrame, frameSize);
+	}
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		for (unsigned long i = 0; i < nChans; i++)
+			shapeFrame(ioFrames[i], frameSize);
+	}
+};
+
+
+class Virtual_Frame : public HISSTools_Frame
+{
+	
+public:
+	
+	Virtual_Frame(unsigned long frameSize, double hopSize) : HISSTools_Frame(frameSize, 1)
+	{
+		setParams(frameSize, hopSize, TRUE);
+	}
+	
+	std::vector<double> mFrames;
+	
+protected:
+	
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		mFrames.insert(mFrames.end(), iFrame, iFrame + frameSize);
+		mFrames.push_back(fractionalOffset);
+	}
+};
+
+
+class Static_Frame : public HISSTools_Frame_Base <Static_Frame>
+{
+	friend class HISSTools_Frame_Base <Static_Frame>;
+	
+public:
+	
+	Static_Frame(unsigned long frameSize, double hopSize) : HISSTools_Frame_Base <Static_Frame> (frameSize, 1)
+	{
+		setParams(frameSize, hopSize, TRUE);
+	}
+	
+	std::vector<double> mFrames;
+	
+private:
+	
+	using HISSTools_Frame_Base <Static_Frame>::process;
+	
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		mFrames.insert(mFrames.end(), iFrame, iFrame + frameSize);
+		mFrames.push_back(fractionalOffset);
+	}
+};
+
+
+static bool testOLA(unsigned long frameSize, unsigned long hopSize, unsigned long nChans)
+{
+	// Power of two frame sizes use the fixed-size engines, others the general engine
+	
+	Virtual_OLA virtualOLA(frameSize, hopSize);
+	Static_OLA staticOLA(frameSize, hopSize);
+	
+	double inputs[2][67], virtualOutputs[2][67], staticOutputs[2][67];
+	double *ins[2] = {inputs[0], inputs[1]};
+	double *virtualOuts[2] = {virtualOutputs[0], virtualOutputs[1]};
+	double *staticOuts[2] = {staticOutputs[0], staticOutputs[1]};
+	bool identical = TRUE;
+	char description[128];
+	
+	for (unsigned long block = 0; block < 400; block++)
+	{
+		for (unsigned long i = 0; i < 2; i++)
+			for (unsigned long j = 0; j < 67; j++)
+				inputs[i][j] = sin(0.01 * (block * 67 + j) * (i + 1));
+		
+		if (nChans == 1)
+		{
+			virtualOLA.overlapAdd(inputs[0], virtualOutputs[0], 67);
+			staticOLA.overlapAdd(inputs[0], staticOutputs[0], 67);
+		}
+		else
+		{
+			virtualOLA.overlapAdd(ins, virtualOuts, 67, nChans);
+			staticOLA.overlapAdd(ins, staticOuts, 67, nChans);
+		}
+		
+		for (unsigned long i = 0; i < nChans; i++)
+			if (memcmp(virtualOutputs[i], staticOutputs[i], 67 * sizeof(double)))
+				identical = FALSE;
+	}
+	
+	snprintf(description, 128, "OLA frame %lu hop %lu channels %lu - CRTP output matches the virtual adapter", frameSize, hopSize, nChans);
+	
+	return HISSTools_Test_Check(identical, description);
+}
+
+
+static bool testFrame(unsigned long frameSize, double hopSize)
+{
+	Virtual_Frame virtualFrame(frameSize, hopSize);
+	Static_Frame staticFrame(frameSize, hopSize);
+	
+	double input[67];
+	char description[128];
+	
+	for (unsigned long block = 0; block < 400; block++)
+	{
+		for (unsigned long j = 0; j < 67; j++)
+			input[j] = sin(0.01 * (block * 67 + j));
+		
+		virtualFrame.streamToFrame(input, 67);
+		staticFrame.streamToFrame(input, 67);
+	}
+	
+	snprintf(description, 128, "Frame size %lu hop %.2f - CRTP frames match the virtual adapter", frameSize, hopSize);
+	
+	return HISSTools_Test_Check(!virtualFrame.mFrames.empty() && virtualFrame.mFrames == staticFrame.mFrames, description);
+}
+
+
+int main()
+{
+	bool success = TRUE;
+	
+	success &= testOLA(1024, 256, 1);
+	success &= testOLA(1024, 256, 2);
+	success &= testOLA(1000, 300, 1);
+	success &= testOLA(1000, 300, 2);
+	success &= testFrame(512, 128.0);
+	success &= testFrame(500, 100.37);
+	
+	return success ? 0 : 1;
+}
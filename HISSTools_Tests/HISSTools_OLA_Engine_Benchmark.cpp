@@ -0,0 +1,147 @@
+
+// Benchmarks the fixed size OLA engines against the generic engine (selected with setFixedEngines())
+// Fixed engines exist for an overlap of 2 or 4 only, so the last configuration (an overlap of 8) times the generic engine against itself as a control
+//
+// The output of the two engines is first checked to be identical, including when switching between them mid-stream
+// Timings use a process() that does nothing, so that only the cost of the engine (buffering and hop bookkeeping) is measured
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_OLA.hpp"
+
+
+class Gain_OLA : public HISSTools_OLA
+{
+	
+public:
+	
+	Gain_OLA() : HISSTools_OLA(8192, 2) {}
+	
+	using HISSTools_OLA::process;
+	
+	void process(double *ioFrame, unsigned long frameSize)
+	{
+		for (unsigned long i = 0; i < frameSize; i++)
+			ioFrame[i] *= 0.25 + i * 1e-6;
+	}
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		for (unsigned long i = 0; i < nChans; i++)
+			process(ioFrames[i], frameSize);
+	}
+};
+
+
+class Empty_OLA : public HISSTools_OLA
+{
+	
+public:
+	
+	Empty_OLA() : HISSTools_OLA(8192, 2) {}
+	
+	using HISSTools_OLA::process;
+	
+	void process(double *ioFrame, unsigned long frameSize) {}
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans) {}
+};
+
+
+static bool compareEngines(unsigned long frameSize, unsigned long overlap, unsigned long nChans)
+{
+	// Compare fixed, generic and switching every 10 blocks (block sizes vary from 1 to 777 samples)
+	
+	Gain_OLA fixed, generic, switching;
+	
+	static double inputs[2][777], outputs[3][2][777];
+	double *ins[2] = {inputs[0], inputs[1]};
+	double *outs[3][2] = {{outputs[0][0], outputs[0][1]}, {outputs[1][0], outputs[1][1]}, {outputs[2][0], outputs[2][1]}};
+	bool identical = TRUE;
+	
+	fixed.setParams(frameSize, frameSize / overlap, TRUE);
+	generic.setParams(frameSize, frameSize / overlap, TRUE);
+	switching.setParams(frameSize, frameSize / overlap, TRUE);
+	generic.setFixedEngines(FALSE);
+	
+	srand(1);
+	
+	for (unsigned long block = 0; block < 300; block++)
+	{
+		unsigned long nSamps = 1 + rand() % 777;
+		
+		for (unsigned long i = 0; i < nChans; i++)
+			for (unsigned long j = 0; j < nSamps; j++)
+				inputs[i][j] = rand() / (double) RAND_MAX - 0.5;
+		
+		switching.setFixedEngines((block / 10) & 1);
+		
+		fixed.overlapAdd(ins, outs[0], nSamps, nChans);
+		generic.overlapAdd(ins, outs[1], nSamps, nChans);
+		switching.overlapAdd(ins, outs[2], nSamps, nChans);
+		
+		for (unsigned long i = 0; i < nChans; i++)
+			if (memcmp(outputs[0][i], outputs[1][i], nSamps * sizeof(double)) || memcmp(outputs[0][i], outputs[2][i], nSamps * sizeof(double)))
+				identical = FALSE;
+	}
+	
+	return identical;
+}
+
+
+static double timeEngine(unsigned long frameSize, unsigned long overlap, unsigned long nChans, bool fixedEngines)
+{
+	// Best of 15 runs of 20000 blocks of 64 samples
+	
+	Empty_OLA ola;
+	
+	static double inputs[2][64], outputs[2][64];
+	double *ins[2] = {inputs[0], inputs[1]};
+	double *outs[2] = {outputs[0], outputs[1]};
+	double best = HUGE_VAL;
+	
+	ola.setParams(frameSize, frameSize / overlap, TRUE);
+	ola.setFixedEngines(fixedEngines);
+	
+	for (unsigned long i = 0; i < 15; i++)
+	{
+		HISSTools_Test_Timer timer;
+		
+		for (unsigned long j = 0; j < 20000; j++)
+		{
+			if (nChans == 1)
+				ola.overlapAdd(inputs[0], outputs[0], 64);
+			else
+				ola.overlapAdd(ins, outs, 64, nChans);
+		}
+		
+		best = std::min(best, timer.elapsed());
+	}
+	
+	return best;
+}
+
+
+int main()
+{
+	const unsigned long configurations[6][2] = {{256, 2}, {1024, 2}, {1024, 4}, {2048, 4}, {4096, 4}, {2048, 8}};
+	
+	bool success = TRUE;
+	
+	for (unsigned long i = 0; i < 6; i++)
+	{
+		for (unsigned long nChans = 1; nChans <= 2; nChans++)
+		{
+			unsigned long frameSize = configurations[i][0];
+			unsigned long overlap = configurations[i][1];
+			
+			bool identical = compareEngines(frameSize, overlap, nChans);
+			double fixedTime = timeEngine(frameSize, overlap, nChans, TRUE);
+			double genericTime = timeEngine(frameSize, overlap, nChans, FALSE);
+			
+			printf("frame %4lu overlap %lu channels %lu  fixed %6.1f ns/sample  generic %6.1f ns/sample  (x%.2f)  output %s\n", frameSize, overlap, nChans, fixedTime * 1e9 / (20000 * 64), genericTime * 1e9 / (20000 * 64), genericTime / fixedTime, identical ? "identical" : "DIFFERS");
+			
+			success &= identical;
+		}
+	}
+	
+	return success ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+
+// Benchmarks HISSTools_Oscillator_Bank at 1k - 10k partials against a scalar sin() per partial per sample loop
+//
+// Every frame glides all partials (so the bank runs its ramping path throughout) with a hop and ramp of 512 samples
+// The scalar loop interpolates frequency and amplitude per sample in the same way
+// Times are given as a percentage of real time at 44.1kHz
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Oscillator_Bank.hpp"
+
+
+// Keeps the output of the scalar loop live (so that it is not optimised away)
+
+static volatile double sSink;
+
+
+static void framePeaks(std::vector<FFTPeak>& peaks, unsigned long frame)
+{
+	unsigned long nPeaks = peaks.size();
+	
+	for (unsigned long i = 0; i < nPeaks; i++)
+	{
+		peaks[i].peakFreq = 0.45 * (i + 1) / (nPeaks + 1) * (1.0 + 0.0001 * (frame & 1));
+		peaks[i].peakAmp = 1e-3 * (1.0 + 0.1 * (frame & 1));
+	}
+}
+
+
+static double timeBank(unsigned long nPartials, unsigned long hopSize, unsigned long nFrames)
+{
+	HISSTools_Oscillator_Bank bank(nPartials);
+	
+	std::vector<FFTPeak> peaks(nPartials);
+	std::vector<double> output(hopSize);
+	
+	HISSTools_Test_Timer timer;
+	
+	for (unsigned long i = 0; i < nFrames; i++)
+	{
+		framePeaks(peaks, i);
+		bank.setPeaks(peaks.data(), nPartials, 65536, hopSize);
+		bank.process(output.data(), hopSize);
+	}
+	
+	return timer.elapsed();
+}
+
+
+static double timeScalar(unsigned long nPartials, unsigned long hopSize, unsigned long nFrames, double& check)
+{
+	std::vector<FFTPeak> peaks(nPartials);
+	std::vector<double> phases(nPartials, 0.0), frequencies(nPartials, 0.0), amplitudes(nPartials, 0.0);
+	std::vector<double> output(hopSize);
+	
+	HISSTools_Test_Timer timer;
+	
+	for (unsigned long i = 0; i < nFrames; i++)
+	{
+		framePeaks(peaks, i);
+		
+		std::fill(output.begin(), output.end(), 0.0);
+		
+		for (unsigned long j = 0; j < nPartials; j++)
+		{
+			double frequency = frequencies[j];
+			double amplitude = amplitudes[j];
+			double phase = phases[j];
+			double frequencyStep = (2.0 * M_PI * peaks[j].peakFreq - frequency) / hopSize;
+			double amplitudeStep = (peaks[j].peakAmp - amplitude) / hopSize;
+			
+			for (unsigned long k = 0; k < hopSize; k++)
+			{
+				output[k] += amplitude * sin(phase);
+				phase += frequency;
+				frequency += frequencyStep;
+				amplitude += amplitudeStep;
+			}
+			
+			phases[j] = fmod(phase, 2.0 * M_PI);
+			frequencies[j] = 2.0 * M_PI * peaks[j].peakFreq;
+			amplitudes[j] = peaks[j].peakAmp;
+		}
+		
+		check += output[0];
+	}
+	
+	return timer.elapsed();
+}
+
+
+int main()
+{
+	const unsigned long partialCounts[4] = {1000, 2000, 5000, 10000};
+	const unsigned long hopSize = 512;
+	const unsigned long nFrames = 40;
+	
+	double duration = nFrames * hopSize / 44100.0;
+	double check = 0.0;
+	
+	printf("%lu frames of %lu samples (%.3f seconds at 44.1kHz)\n\n", nFrames, hopSize, duration);
+	
+	for (unsigned long i = 0; i < 4; i++)
+	{
+		unsigned long nPartials = partialCounts[i];
+		
+		double bankTime = timeBank(nPartials, hopSize, nFrames);
+		double scalarTime = timeScalar(nPartials, hopSize, nFrames, check);
+		
+		printf("%5lu partials  bank %7.1f%% (%.2f ns per partial sample)  sin() loop %7.1f%%  (x%.1f)\n", nPartials, 100.0 * bankTime / duration, bankTime * 1e9 / (nPartials * nFrames * hopSize), 100.0 * scalarTime / duration, scalarTime / bankTime);
+	}
+	
+	sSink = check;
+	
+	return 0;
+}
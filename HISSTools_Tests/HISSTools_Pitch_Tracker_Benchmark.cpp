@@ -0,0 +1,116 @@
+
+// Benchmarks HISSTools_Pitch_Tracker against a direct (O(N^2)) YIN difference function at several frame sizes and hops
+//
+// Both are fed the same harmonic tone in 64 sample blocks and the total time is reported relative to real time (at 44.1kHz)
+// The estimate of the tracker is checked against the known frequency of the tone
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Pitch_Tracker.hpp"
+
+
+class Direct_YIN : public HISSTools_Frame
+{
+	
+public:
+	
+	Direct_YIN(unsigned long frameSize, unsigned long hopSize) : HISSTools_Frame(frameSize, 1), mDifference(frameSize >> 1)
+	{
+		setParams(frameSize, hopSize, TRUE);
+		mLag = 0.0;
+	}
+	
+	double mLag;
+	
+protected:
+	
+	void process(double *iFrame, unsigned long frameSize, double fractionalOffset)
+	{
+		// Cumulative mean normalised difference over the first half of the frame, with the first dip below 0.1 taken
+		// Lags are limited as for the tracker (to a minimum frequency of 50Hz at 44.1kHz)
+		
+		unsigned long window = frameSize >> 1;
+		unsigned long maxLag = std::min(window, 884UL);
+		double runningSum = 0.0;
+		
+		mLag = 0.0;
+		mDifference[0] = 1.0;
+		
+		for (unsigned long lag = 1; lag < maxLag; lag++)
+		{
+			double sum = 0.0;
+			
+			for (unsigned long j = 0; j < window; j++)
+				sum += (iFrame[j] - iFrame[j + lag]) * (iFrame[j] - iFrame[j + lag]);
+			
+			runningSum += sum;
+			mDifference[lag] = runningSum ? sum * lag / runningSum : 1.0;
+		}
+		
+		for (unsigned long lag = 2; lag + 1 < maxLag; lag++)
+		{
+			if (mDifference[lag] < 0.1 && mDifference[lag] <= mDifference[lag + 1])
+			{
+				mLag = (double) lag;
+				break;
+			}
+		}
+	}
+	
+private:
+	
+	std::vector<double> mDifference;
+};
+
+
+template <class T>
+double timeTracker(T& tracker, const std::vector<double>& input)
+{
+	HISSTools_Test_Timer timer;
+	
+	for (unsigned long i = 0; i + 64 <= input.size(); i += 64)
+		tracker.streamToFrame(const_cast<double *>(input.data()) + i, 64);
+	
+	return timer.elapsed();
+}
+
+
+int main()
+{
+	const double samplingRate = 44100.0;
+	const double frequency = 220.7;
+	const unsigned long frameSizes[4] = {512, 1024, 2048, 4096};
+	const unsigned long hopDivisions[3] = {2, 4, 8};
+	
+	std::vector<double> input(44100);
+	
+	for (unsigned long i = 0; i < input.size(); i++)
+	{
+		input[i] = 0.0;
+		
+		for (unsigned long j = 1; j < 8; j++)
+			input[i] += sin(2.0 * M_PI * frequency * j * i / samplingRate) / j;
+	}
+	
+	printf("1 second of a %.1fHz harmonic tone (times as a percentage of real time)\n\n", frequency);
+	
+	for (unsigned long i = 0; i < 4; i++)
+	{
+		for (unsigned long j = 0; j < 3; j++)
+		{
+			unsigned long frameSize = frameSizes[i];
+			unsigned long hopSize = frameSize / hopDivisions[j];
+			
+			HISSTools_Pitch_Tracker tracker(frameSize);
+			Direct_YIN direct(frameSize, hopSize);
+			
+			tracker.setParams(frameSize, hopSize, TRUE);
+			
+			double trackerTime = timeTracker(tracker, input);
+			double directTime = timeTracker(direct, input);
+			
+			printf("frame %4lu hop %4lu  FFT %6.2f%%  direct %7.2f%%  (x%5.1f)  estimate %.3fHz (direct lag %.0f)\n", frameSize, hopSize, trackerTime * 100.0, directTime * 100.0, directTime / trackerTime, tracker.getFrequency(), direct.mLag);
+		}
+	}
+	
+	return 0;
+}
@@ -0,0 +1,116 @@
+
+// Stress benchmark for HISSTools_Scheduler with hundreds of synthetic OLA instances
+//
+// Usage: HISSTools_Scheduler_Benchmark [instances] (default 200)
+// All instances are driven from one simulated audio callback (64 samples at 44.1kHz) with their hops aligned (the worst case)
+// Each mode runs for 2000 callbacks in real time - direct processing on the callback, then pipelined processing on the scheduler
+// Reports percentiles of the callback time, stalls (waiting on the previous frame) and jobs that finished after their deadline
+// The pipelined path has not kept up if there are any stalls or late jobs, or if its p99 is worse than direct processing
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_OLA.hpp"
+
+#include <thread>
+
+
+class Synthetic_OLA final : public HISSTools_OLA
+{
+	
+public:
+	
+	Synthetic_OLA() : HISSTools_OLA(2048, 1)
+	{
+		setParams(2048, 512, TRUE);
+	}
+	
+	~Synthetic_OLA()
+	{
+		stopPipeline();
+	}
+	
+protected:
+	
+	void process(double *ioFrame, unsigned long frameSize)
+	{
+		// A fixed, moderate load per frame
+		
+		for (unsigned long i = 0; i < 2; i++)
+			for (unsigned long j = 0; j < frameSize; j++)
+				ioFrame[j] = sin(ioFrame[j]) * 0.999;
+	}
+};
+
+
+int main(int argc, char **argv)
+{
+	const unsigned long blockSize = 64;
+	const unsigned long nBlocks = 2000;
+	const double samplingRate = 44100.0;
+	
+	unsigned long nInstances = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+	
+	std::chrono::microseconds blockPeriod((long long) (1e6 * blockSize / samplingRate));
+	
+	unsigned long nWorkers = HISSTools_Scheduler::get().getNumWorkers();
+	double directP99 = 0.0;
+	
+	printf("%lu instances, frame 2048 hop 512, scheduler workers %lu, callback period %.3f ms\n\n", nInstances, nWorkers, blockPeriod.count() * 1e-3);
+	
+	for (int pipelined = 0; pipelined < 2; pipelined++)
+	{
+		std::vector<Synthetic_OLA *> instances;
+		std::vector<double> callbackTimes;
+		
+		double input[blockSize], output[blockSize];
+		
+		unsigned long long stalls = 0;
+		unsigned long long lateJobs = 0;
+		
+		for (unsigned long i = 0; i < blockSize; i++)
+			input[i] = sin(0.1 * i);
+		
+		for (unsigned long i = 0; i < nInstances; i++)
+		{
+			instances.push_back(new Synthetic_OLA);
+			instances.back()->setPipelined(pipelined, samplingRate);
+		}
+		
+		std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+		
+		for (unsigned long i = 0; i < nBlocks; i++)
+		{
+			HISSTools_Test_Timer timer;
+			
+			for (unsigned long j = 0; j < nInstances; j++)
+				instances[j]->overlapAdd(input, output, blockSize);
+			
+			callbackTimes.push_back(timer.elapsed());
+			
+			next += blockPeriod;
+			std::this_thread::sleep_until(next);
+		}
+		
+		for (unsigned long i = 0; i < nInstances; i++)
+		{
+			stalls += instances[i]->getPipelineStalls();
+			
+			if (pipelined)
+				lateJobs += instances[i]->getSchedulerClient()->getLateJobs();
+			
+			delete instances[i];
+		}
+		
+		double p99 = HISSTools_Test_Percentile(callbackTimes, 99.0);
+		
+		printf("%-10s p50 %7.3f ms  p99 %7.3f ms  max %7.3f ms  stalls %llu  late jobs %llu\n", pipelined ? "scheduled" : "direct", HISSTools_Test_Percentile(callbackTimes, 50.0) * 1e3, p99 * 1e3, HISSTools_Test_Percentile(callbackTimes, 100.0) * 1e3, stalls, lateJobs);
+		
+		if (!pipelined)
+			directP99 = p99;
+		else if (stalls || lateJobs || p99 > directP99)
+			printf("\nThe pipelined path did NOT keep up with %lu instances on %lu workers (%s)\n", nInstances, nWorkers, (stalls || lateJobs) ? "stalls or late jobs" : "p99 worse than direct");
+		else
+			printf("\nThe pipelined path kept up with %lu instances on %lu workers\n", nInstances, nWorkers);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,84 @@
+
+// Profiles HISSTools_Spectral_Denoiser at 64 channels against a fixed per-hop budget (the duration of one hop at 44.1kHz)
+//
+// Reports the mean time per hop of each stage, the 99th percentile time of the audio callbacks (64 samples) and the budget overruns
+// Each configuration is run with the budget disabled and then enabled (when the wavelet shrinkage is skipped on overrun)
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_Spectral_Denoiser.hpp"
+
+#include <random>
+
+
+static void profile(const HISSTools_Wavelet *wavelet, unsigned long frameSize, unsigned long hopSize, bool budget)
+{
+	const unsigned long nChans = 64;
+	const unsigned long blockSize = 64;
+	const unsigned long length = 88200;
+	const double samplingRate = 44100.0;
+	const char *stageNames[kDenoiseNumStages] = {"estimate", "noise", "gain", "synthesis"};
+	
+	HISSTools_Spectral_Denoiser denoiser(frameSize, nChans, wavelet);
+	
+	std::vector<std::vector<double> > inputs(nChans, std::vector<double>(length)), outputs(nChans, std::vector<double>(length));
+	std::vector<double *> ins(nChans), outs(nChans);
+	std::vector<double> callbackTimes;
+	std::mt19937 generator(1);
+	std::normal_distribution<double> noise(0.0, 0.1);
+	
+	double hopBudget = hopSize / samplingRate;
+	
+	for (unsigned long i = 0; i < nChans; i++)
+		for (unsigned long j = 0; j < length; j++)
+			inputs[i][j] = noise(generator) + 0.5 * sin(2.0 * M_PI * 0.01 * (i + 1) * j);
+	
+	denoiser.setSamplingRate(samplingRate);
+	denoiser.setParams(frameSize, hopSize, TRUE);
+	denoiser.setBudget(budget ? hopBudget : 0.0);
+	denoiser.resetTimings();
+	
+	for (unsigned long i = 0; i + blockSize <= length; i += blockSize)
+	{
+		for (unsigned long j = 0; j < nChans; j++)
+		{
+			ins[j] = inputs[j].data() + i;
+			outs[j] = outputs[j].data() + i;
+		}
+		
+		HISSTools_Test_Timer timer;
+		denoiser.overlapAdd(ins.data(), outs.data(), blockSize, nChans);
+		callbackTimes.push_back(timer.elapsed());
+	}
+	
+	double hopTime = 0.0;
+	
+	printf("frame %lu hop %lu (budget %s %.2f ms)\n", frameSize, hopSize, budget ? "on" : "off", hopBudget * 1e3);
+	
+	for (unsigned long i = 0; i < kDenoiseNumStages; i++)
+	{
+		double stageTime = denoiser.getStageTime((DenoiserStage) i);
+		printf("    %-10s %7.3f ms per hop\n", stageNames[i], stageTime * 1e3);
+		hopTime += stageTime;
+	}
+	
+	printf("    total      %7.3f ms per hop (%.1f%% of budget)  p99 callback %.3f ms  overruns %llu\n\n", hopTime * 1e3, 100.0 * hopTime / hopBudget, HISSTools_Test_Percentile(callbackTimes, 99.0) * 1e3, denoiser.getOverruns());
+}
+
+
+int main()
+{
+	// Daubechies 4 tap wavelet (analysis order)
+	
+	static const double daubechies4[4] = {-0.1294095225512604, 0.2241438680420134, 0.8365163037378079, 0.4829629131445341};
+	
+	HISSTools_Wavelet wavelet(daubechies4, 4);
+	
+	printf("64 channels, 2 seconds at 44.1kHz in blocks of 64 samples\n\n");
+	
+	profile(&wavelet, 1024, 256, FALSE);
+	profile(&wavelet, 1024, 256, TRUE);
+	profile(&wavelet, 2048, 512, FALSE);
+	profile(&wavelet, 2048, 512, TRUE);
+	
+	return 0;
+}
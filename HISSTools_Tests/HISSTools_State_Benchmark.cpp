@@ -0,0 +1,188 @@
+
+// Benchmarks state snapshots (saveState() / restoreState()) of the streaming classes
+//
+// For each class a stream is run, saved and restored into a second object, and both are then run on and compared
+// Reports the snapshot size, the median save and restore times and whether processing after the restore is bit-identical
+
+#include "HISSTools_Test_Utility.hpp"
+#include "HISSTools_OLA.hpp"
+#include "HISSTools_Frame.hpp"
+#include "HISSTools_Frame_Delay.hpp"
+#include "HISSTools_IOStream.hpp"
+#include "HISSTools_VU_Ballistics.hpp"
+
+
+static double sInputs[2][262144];
+
+
+class Shaping_OLA : public HISSTools_OLA
+{
+	
+public:
+	
+	Shaping_OLA() : HISSTools_OLA(4096, 2)
+	{
+		setParams(4096, 1024, TRUE);
+	}
+	
+protected:
+	
+	void process(double **ioFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		for (unsigned long i = 0; i < nChans; i++)
+			for (unsigned long j = 0; j < frameSize; j++)
+				ioFrames[i][j] *= 0.1 * (j % 7 + 1);
+	}
+};
+
+
+class Summing_Frame : public HISSTools_Frame
+{
+	
+public:
+	
+	Summing_Frame() : HISSTools_Frame(2048, 2)
+	{
+		setParams(2048, 300.5);
+		setFractionalFrames(16);
+		mSum = 0.0;
+	}
+	
+	double mSum;
+	
+protected:
+	
+	void process(double **iFrames, unsigned long frameSize, unsigned long nChans)
+	{
+		for (unsigned long i = 0; i < frameSize; i++)
+			mSum += iFrames[0][i] * (i + 1) + iFrames[1][i];
+	}
+};
+
+
+// Each run function processes block k and returns a value that depends on the output
+
+static double runOLA(Shaping_OLA& ola, unsigned long k)
+{
+	double outputs[2][256], sum = 0.0;
+	double *ins[2] = {sInputs[0] + k * 256, sInputs[1] + k * 256};
+	double *outs[2] = {outputs[0], outputs[1]};
+	
+	ola.overlapAdd(ins, outs, 256, 2);
+	
+	for (unsigned long i = 0; i < 256; i++)
+		sum += outputs[0][i] * (i + 1) + outputs[1][i];
+	
+	return sum;
+}
+
+
+static double runFrame(Summing_Frame& frame, unsigned long k)
+{
+	double *ins[2] = {sInputs[0] + k * 256, sInputs[1] + k * 256};
+	
+	frame.mSum = 0.0;
+	frame.streamToFrame(ins, 2, 256);
+	
+	return frame.mSum + frame.getFrameHostTime();
+}
+
+
+static double runFrameDelay(HISSTools_Frame_Delay& delay, unsigned long k)
+{
+	double outputs[2][4096], sum = 0.0;
+	double *ins[2] = {sInputs[0] + (k % 60) * 4096, sInputs[1] + (k % 60) * 4096};
+	double *outs[2] = {outputs[0], outputs[1]};
+	
+	delay.delayIO(ins, outs, 4096, 2, 100);
+	
+	for (unsigned long i = 0; i < 4096; i++)
+		sum += outputs[0][i] * (i + 1) + outputs[1][i];
+	
+	return sum;
+}
+
+
+static double runIOStream(HISSTools_IOStream& stream, unsigned long k)
+{
+	double outputs[2][80];
+	double *ins[2] = {sInputs[0] + k * 100, sInputs[1] + k * 100};
+	double *outs[2] = {outputs[0], outputs[1]};
+	
+	stream.write(ins, 2, 100, 0);
+	stream.readInterpolated(outs, 2, 80, 0, 1.25, HISSTools_IOStream::kInterpCubic);
+	
+	return outputs[0][7] + outputs[1][79];
+}
+
+
+static double runVU(HISSTools_VU_Ballistics& vu, unsigned long k)
+{
+	double *ins[2] = {sInputs[0] + k * 64, sInputs[1] + k * 64};
+	
+	vu.calcVULevels(ins, 2, 64);
+	
+	return vu.getPeak() + vu.getRMS() + vu.getPeakHold();
+}
+
+
+template <class T>
+bool benchmarkState(const char *name, T& a, T& b, double (*run)(T&, unsigned long), unsigned long split, unsigned long total)
+{
+	std::vector<double> saveTimes, restoreTimes;
+	bool identical = TRUE;
+	bool restored = TRUE;
+	
+	for (unsigned long i = 0; i < split; i++)
+		run(a, i);
+	
+	std::vector<char> data(a.getStateSize());
+	
+	for (unsigned long i = 0; i < 100; i++)
+	{
+		HISSTools_Test_Timer saveTimer;
+		a.saveState(data.data(), data.size());
+		saveTimes.push_back(saveTimer.elapsed());
+		
+		HISSTools_Test_Timer restoreTimer;
+		restored &= b.restoreState(data.data(), data.size());
+		restoreTimes.push_back(restoreTimer.elapsed());
+	}
+	
+	for (unsigned long i = split; i < total; i++)
+		if (run(a, i) != run(b, i))
+			identical = FALSE;
+	
+	printf("%-18s %9lu bytes  save %8.2f us  restore %8.2f us  after restore %s\n", name, (unsigned long) data.size(), HISSTools_Test_Percentile(saveTimes, 50.0) * 1e6, HISSTools_Test_Percentile(restoreTimes, 50.0) * 1e6, restored && identical ? "identical" : "DIFFERS");
+	
+	return restored && identical;
+}
+
+
+int main()
+{
+	bool success = TRUE;
+	
+	srand(1);
+	
+	for (unsigned long i = 0; i < 2; i++)
+		for (unsigned long j = 0; j < 262144; j++)
+			sInputs[i][j] = rand() / (double) RAND_MAX - 0.5;
+	
+	Shaping_OLA olaA, olaB;
+	success &= benchmarkState("OLA 4096 x 2", olaA, olaB, runOLA, 100, 400);
+	
+	Summing_Frame frameA, frameB;
+	success &= benchmarkState("Frame 2048 x 2", frameA, frameB, runFrame, 100, 400);
+	
+	HISSTools_Frame_Delay delayA(4096, 128, 2, kFrameStoreFloat), delayB(4096, 128, 2, kFrameStoreFloat);
+	success &= benchmarkState("Frame Delay float", delayA, delayB, runFrameDelay, 150, 250);
+	
+	HISSTools_IOStream streamA(HISSTools_IOStream::kOutput, 1000, 2), streamB(HISSTools_IOStream::kOutput, 1000, 2);
+	success &= benchmarkState("IOStream", streamA, streamB, runIOStream, 100, 400);
+	
+	HISSTools_VU_Ballistics vuA, vuB;
+	success &= benchmarkState("VU Ballistics", vuA, vuB, runVU, 100, 400);
+	
+	return success ? 0 : 1;
+}
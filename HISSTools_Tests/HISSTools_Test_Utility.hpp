@@ -0,0 +1,76 @@
+#ifndef __HISSTOOLS_TEST_UTILITY__
+#define __HISSTOOLS_TEST_UTILITY__
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// The headers expect the host environment to define these
+
+#ifndef TRUE
+#define TRUE true
+#endif
+
+#ifndef FALSE
+#define FALSE false
+#endif
+
+
+// Shared helpers for the standalone tests and benchmarks (see the Makefile)
+
+
+class HISSTools_Test_Timer
+{
+
+public:
+	
+	HISSTools_Test_Timer()
+	{
+		start();
+	}
+	
+	void start()
+	{
+		mStart = std::chrono::steady_clock::now();
+	}
+	
+	double elapsed()
+	{
+		// Seconds since the last call to start()
+		
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+	}
+	
+private:
+	
+	std::chrono::steady_clock::time_point mStart;
+};
+
+
+static inline double HISSTools_Test_Percentile(std::vector<double> values, double percentile)
+{
+	// Nearest rank percentile (0 - 100) of a set of values
+	
+	if (values.empty())
+		return 0.0;
+	
+	std::sort(values.begin(), values.end());
+	
+	unsigned long rank = (unsigned long) ceil(percentile / 100.0 * values.size());
+	
+	return values[rank ? std::min(rank, (unsigned long) values.size()) - 1 : 0];
+}
+
+
+static inline bool HISSTools_Test_Check(bool condition, const char *description)
+{
+	printf("%s: %s\n", condition ? "PASS" : "FAIL", description);
+	
+	return condition;
+}
+
+
+#endif
@@ -0,0 +1,398 @@
+
+
+#ifndef __HISSTOOLS_SCHEDULER__
+#define __HISSTOOLS_SCHEDULER__
+
+#include "HISSTools_ThreadSafety.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////// Deadline Scheduler /////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Process-wide pool of worker threads shared by all instances (earliest deadline first)
+//
+// Each instance registers as a client and submits jobs with a deadline from its audio thread (without locking)
+// Jobs from all clients are run in deadline order, so hops that fall on the same callback are spread over the workers
+// Clients whose smoothed job time exceeds their budget are served after clients that are within budget
+
+class HISSTools_Scheduler
+{
+
+public:
+
+	typedef std::chrono::steady_clock Clock;
+	
+	enum JobState {kJobIdle, kJobQueued, kJobDone};
+	
+	class Client;
+	
+	class Job
+	{
+		friend class HISSTools_Scheduler;
+	
+	public:
+	
+		Job() : mState(kJobIdle), mClient(NULL), mDemoted(FALSE)
+		{
+		}
+		
+		virtual ~Job()
+		{
+		}
+		
+		// Called on a worker thread
+		
+		virtual void run() = 0;
+		
+		bool isQueued()
+		{
+			return mState.load(std::memory_order_acquire) == kJobQueued;
+		}
+		
+		bool isDone()
+		{
+			return mState.load(std::memory_order_acquire) == kJobDone;
+		}
+		
+		void wait()
+		{
+			while (isQueued())
+				std::this_thread::yield();
+		}
+		
+		void runNow()
+		{
+			// Run on the calling thread (for instance if the job could not be submitted)
+			
+			run();
+			mState.store(kJobDone, std::memory_order_release);
+		}
+		
+		void complete()
+		{
+			// Mark an idle job as done without running it (for instance when its results have been restored)
+			
+			mState.store(kJobDone, std::memory_order_release);
+		}
+		
+		void clear()
+		{
+			// Return a finished job to the idle state (the owner does this once the results are consumed)
+			
+			wait();
+			mState.store(kJobIdle, std::memory_order_relaxed);
+		}
+	
+	private:
+	
+		std::atomic<int> mState;
+		Clock::time_point mDeadline;
+		Client *mClient;
+		bool mDemoted;
+	};
+
+
+private:
+
+	static const unsigned long kClientQueueSize = 16;
+	static const unsigned long kMaxClients = 1024;
+	static const unsigned long kMaxJobs = 4096;
+	static const unsigned long kMaxWorkers = 64;
+
+
+public:
+
+	class Client
+	{
+		friend class HISSTools_Scheduler;
+	
+	public:
+	
+		void setBudget(double seconds)
+		{
+			// Expected time per job (zero for no budget)
+			
+			mBudget.store(std::max(0.0, seconds), std::memory_order_relaxed);
+		}
+		
+		double getMeanTime()
+		{
+			// Smoothed time per job (in seconds)
+			
+			return mMeanTime.load(std::memory_order_relaxed);
+		}
+		
+		unsigned long long getJobs()
+		{
+			return mJobs.load(std::memory_order_relaxed);
+		}
+		
+		unsigned long long getOverruns()
+		{
+			// Jobs that took longer than the budget
+			
+			return mOverruns.load(std::memory_order_relaxed);
+		}
+		
+		unsigned long long getLateJobs()
+		{
+			// Jobs that finished after their deadline
+			
+			return mLateJobs.load(std::memory_order_relaxed);
+		}
+	
+	private:
+	
+		Client() : mBudget(0.0), mMeanTime(0.0), mJobs(0), mOverruns(0), mLateJobs(0)
+		{
+		}
+		
+		bool isDemoted()
+		{
+			double budget = mBudget.load(std::memory_order_relaxed);
+			
+			return budget && mMeanTime.load(std::memory_order_relaxed) > budget;
+		}
+		
+		HISSTools_LockFreeQueue <Job *, kClientQueueSize> mQueue;
+		
+		std::atomic<double> mBudget;
+		std::atomic<double> mMeanTime;
+		std::atomic<unsigned long long> mJobs;
+		std::atomic<unsigned long long> mOverruns;
+		std::atomic<unsigned long long> mLateJobs;
+	};
+	
+	
+	static HISSTools_Scheduler& get()
+	{
+		// Created on first use (threadsafe) and shut down at exit
+		
+		static HISSTools_Scheduler scheduler;
+		
+		return scheduler;
+	}
+	
+	// Non-copyable
+	
+	HISSTools_Scheduler(const HISSTools_Scheduler&) = delete;
+	HISSTools_Scheduler& operator=(const HISSTools_Scheduler&) = delete;
+	
+	Client *registerClient()
+	{
+		// N.B. this allocates memory and locks (call it when not processing)
+		
+		std::lock_guard<std::mutex> lock(mMutex);
+		
+		if (mNClients == kMaxClients)
+			return NULL;
+		
+		Client *client = new Client();
+		mClients[mNClients++] = client;
+		
+		return client;
+	}
+	
+	void unregisterClient(Client *client)
+	{
+		// N.B. all jobs submitted by the client must have finished (wait for them first)
+		
+		std::lock_guard<std::mutex> lock(mMutex);
+		
+		for (unsigned long i = 0; i < mNClients; i++)
+		{
+			if (mClients[i] == client)
+			{
+				mClients[i] = mClients[--mNClients];
+				delete client;
+				break;
+			}
+		}
+	}
+	
+	bool submit(Client *client, Job *job, double deadline)
+	{
+		// Queue a job that should finish within deadline seconds (lock-free, but only one thread may submit for each client)
+		// If the client queue is full FALSE is returned and the job is left idle
+		
+		job->mDeadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(deadline));
+		job->mClient = client;
+		job->mState.store(kJobQueued, std::memory_order_relaxed);
+		
+		if (client->mQueue.push(job) == FALSE)
+		{
+			job->mState.store(kJobIdle, std::memory_order_relaxed);
+			return FALSE;
+		}
+		
+		mWake.notify_one();
+		
+		return TRUE;
+	}
+	
+	unsigned long getNumWorkers()
+	{
+		return mNWorkers;
+	}
+
+
+private:
+
+	HISSTools_Scheduler() : mExit(FALSE), mNClients(0), mNJobs(0)
+	{
+		// Leave one core for the audio thread where possible
+		
+		unsigned long nCores = std::thread::hardware_concurrency();
+		
+		mNWorkers = nCores > 2 ? nCores - 1 : 1UL;
+		mNWorkers = mNWorkers < kMaxWorkers ? mNWorkers : kMaxWorkers;
+		
+		for (unsigned long i = 0; i < mNWorkers; i++)
+			mWorkers[i] = new std::thread(&HISSTools_Scheduler::worker, this);
+	}
+	
+	~HISSTools_Scheduler()
+	{
+		mExit.store(TRUE, std::memory_order_release);
+		mWake.notify_all();
+		
+		for (unsigned long i = 0; i < mNWorkers; i++)
+		{
+			mWorkers[i]->join();
+			delete mWorkers[i];
+		}
+		
+		for (unsigned long i = 0; i < mNClients; i++)
+			delete mClients[i];
+	}
+	
+	// Job heap (ordered by budget and then by deadline)
+	
+	static bool before(Job *a, Job *b)
+	{
+		if (a->mDemoted != b->mDemoted)
+			return b->mDemoted;
+		
+		return a->mDeadline < b->mDeadline;
+	}
+	
+	void pushJob(Job *job)
+	{
+		unsigned long i = mNJobs++;
+		
+		for (; i && before(job, mJobs[(i - 1) >> 1]); i = (i - 1) >> 1)
+			mJobs[i] = mJobs[(i - 1) >> 1];
+		
+		mJobs[i] = job;
+	}
+	
+	Job *popJob()
+	{
+		Job *job = mJobs[0];
+		Job *last = mJobs[--mNJobs];
+		unsigned long i = 0;
+		
+		for (unsigned long child = 1; child < mNJobs; i = child, child = (child << 1) + 1)
+		{
+			if (child + 1 < mNJobs && before(mJobs[child + 1], mJobs[child]))
+				child++;
+			if (!before(mJobs[child], last))
+				break;
+			
+			mJobs[i] = mJobs[child];
+		}
+		
+		mJobs[i] = last;
+		
+		return job;
+	}
+	
+	Job *nextJob()
+	{
+		// Called with the lock held - moves submitted jobs into the heap and takes the most urgent
+		
+		Job *job;
+		
+		for (unsigned long i = 0; i < mNClients; i++)
+		{
+			Client *client = mClients[i];
+			bool demoted = client->isDemoted();
+			
+			while (mNJobs < kMaxJobs && client->mQueue.pop(job))
+			{
+				job->mDemoted = demoted;
+				pushJob(job);
+			}
+		}
+		
+		return mNJobs ? popJob() : NULL;
+	}
+	
+	void worker()
+	{
+		while (mExit.load(std::memory_order_acquire) == FALSE)
+		{
+			Job *job;
+			
+			{
+				std::unique_lock<std::mutex> lock(mMutex);
+				
+				if (!(job = nextJob()))
+				{
+					// Sleep until woken (the timeout covers a wake that arrives before the wait)
+					
+					mWake.wait_for(lock, std::chrono::milliseconds(1));
+					continue;
+				}
+			}
+			
+			Client *client = job->mClient;
+			Clock::time_point start = Clock::now();
+			
+			job->run();
+			
+			Clock::time_point end = Clock::now();
+			double time = std::chrono::duration<double>(end - start).count();
+			double budget = client->mBudget.load(std::memory_order_relaxed);
+			double meanTime = client->mMeanTime.load(std::memory_order_relaxed);
+			
+			// Update the client statistics before the job is marked done (after which the client may be unregistered)
+			
+			client->mMeanTime.store(meanTime + 0.1 * (time - meanTime), std::memory_order_relaxed);
+			client->mJobs.fetch_add(1, std::memory_order_relaxed);
+			
+			if (budget && time > budget)
+				client->mOverruns.fetch_add(1, std::memory_order_relaxed);
+			if (end > job->mDeadline)
+				client->mLateJobs.fetch_add(1, std::memory_order_relaxed);
+			
+			job->mState.store(kJobDone, std::memory_order_release);
+		}
+	}
+	
+	// Threads
+	
+	std::thread *mWorkers[kMaxWorkers];
+	unsigned long mNWorkers;
+	std::atomic<bool> mExit;
+	
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	
+	// Clients and Jobs
+	
+	Client *mClients[kMaxClients];
+	unsigned long mNClients;
+	
+	Job *mJobs[kMaxJobs];
+	unsigned long mNJobs;
+};
+
+#endif	/* __HISSTOOLS_SCHEDULER__ */
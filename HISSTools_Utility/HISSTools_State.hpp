@@ -0,0 +1,198 @@
+
+
+#ifndef __HISSTOOLS_STATE__
+#define __HISSTOOLS_STATE__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////// State Snapshots ////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Versioned binary snapshots of streaming state (for resuming renders and restoring precomputed states when seeking)
+//
+// A snapshot is a header (tag, version and total size) followed by raw values in native byte order
+// Snapshots are plain memory copies - they may be stored and copied freely, but are not portable between architectures
+// A state is only restored into an object with a matching configuration (otherwise the object is left untouched)
+
+struct HISSTools_StateHeader
+{
+	uint32_t mTag;
+	uint32_t mVersion;
+	uint64_t mSize;
+};
+
+
+// Writes values in sequence (with no data it only counts, so the same code gives the size of a state)
+
+class HISSTools_StateWriter
+{
+
+public:
+
+	HISSTools_StateWriter(void *data = NULL, unsigned long size = 0) : mData((unsigned char *) data), mSize(size), mPosition(0), mValid(TRUE)
+	{
+	}
+	
+	unsigned long beginState(uint32_t tag, uint32_t version)
+	{
+		// Write a header (the size is filled in by endState()) and return its position
+		
+		HISSTools_StateHeader header;
+		unsigned long position = mPosition;
+		
+		header.mTag = tag;
+		header.mVersion = version;
+		header.mSize = 0;
+		
+		write(header);
+		
+		return position;
+	}
+	
+	void endState(unsigned long position)
+	{
+		uint64_t size = mPosition - position;
+		
+		if (mData && mValid == TRUE)
+			memcpy(mData + position + offsetof(HISSTools_StateHeader, mSize), &size, sizeof(uint64_t));
+	}
+	
+	template <class T>
+	void write(const T& value)
+	{
+		write(&value, 1);
+	}
+	
+	template <class T>
+	void write(const T *values, unsigned long count)
+	{
+		unsigned long bytes = count * sizeof(T);
+		
+		if (mData && mPosition + bytes <= mSize)
+			memcpy(mData + mPosition, values, bytes);
+		else if (mData)
+			mValid = FALSE;
+		
+		mPosition += bytes;
+	}
+	
+	unsigned long getPosition()
+	{
+		return mPosition;
+	}
+	
+	bool isValid()
+	{
+		return mValid;
+	}
+
+private:
+
+	unsigned char *mData;
+	unsigned long mSize;
+	unsigned long mPosition;
+	bool mValid;
+};
+
+
+// Reads values in sequence (reads past the end leave the values unchanged and invalidate the reader)
+
+class HISSTools_StateReader
+{
+
+public:
+
+	HISSTools_StateReader(const void *data, unsigned long size) : mData((const unsigned char *) data), mSize(data ? size : 0), mPosition(0), mValid(TRUE)
+	{
+	}
+	
+	bool beginState(uint32_t tag, uint32_t version, unsigned long size = 0)
+	{
+		// Check the header (the size is checked against the data and against size if it is non-zero)
+		
+		HISSTools_StateHeader header = HISSTools_StateHeader();
+		unsigned long position = mPosition;
+		
+		read(header);
+		
+		if (mValid == FALSE)
+			return FALSE;
+		
+		mValid = header.mTag == tag && header.mVersion == version && header.mSize <= mSize - position;
+		mValid = mValid == TRUE && (!size || header.mSize == size);
+		
+		return mValid;
+	}
+	
+	bool canRead(unsigned long bytes)
+	{
+		// Check that further data is available (before anything is restored from it)
+		
+		mValid = mValid == TRUE && bytes <= mSize - mPosition;
+		
+		return mValid;
+	}
+	
+	template <class T>
+	void read(T& value)
+	{
+		read(&value, 1);
+	}
+	
+	template <class T>
+	void read(T *values, unsigned long count)
+	{
+		unsigned long bytes = count * sizeof(T);
+		
+		if (mValid == TRUE && mPosition + bytes <= mSize)
+			memcpy(values, mData + mPosition, bytes);
+		else
+			mValid = FALSE;
+		
+		mPosition += bytes;
+	}
+	
+	template <class T>
+	bool check(const T& expected)
+	{
+		// Read a configuration value and check that it matches
+		
+		T value = T();
+		
+		read(value);
+		
+		if (mValid == FALSE)
+			return FALSE;
+		
+		mValid = value == expected;
+		
+		return mValid;
+	}
+	
+	bool isValid()
+	{
+		return mValid;
+	}
+
+private:
+
+	const unsigned char *mData;
+	unsigned long mSize;
+	unsigned long mPosition;
+	bool mValid;
+};
+
+
+// Tags
+
+const uint32_t kStateTagIOStream = 0x494F5354;			// 'IOST'
+const uint32_t kStateTagOLA = 0x4F4C4120;				// 'OLA '
+const uint32_t kStateTagFrame = 0x4652414D;				// 'FRAM'
+const uint32_t kStateTagFrameDelay = 0x46444C59;		// 'FDLY'
+const uint32_t kStateTagVU = 0x56554241;				// 'VUBA'
+const uint32_t kStateTagResampler = 0x52534D50;			// 'RSMP'
+
+#endif	/* __HISSTOOLS_STATE__ */
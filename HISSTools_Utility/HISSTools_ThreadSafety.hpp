@@ -46,6 +46,69 @@ public:
 };
 
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////// Lock-free Queue ///////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Fixed size single producer / single consumer FIFO (holds up to Size - 1 items)
+// Multiple producers must serialise their pushes (for instance with a HISSTools_SpinLock)
+
+template <class T, unsigned long Size>
+class HISSTools_LockFreeQueue
+{
+
+public:
+
+	HISSTools_LockFreeQueue() : mRead(0), mWrite(0)
+	{
+	}
+	
+    // Non-copyable
+    
+    HISSTools_LockFreeQueue(const HISSTools_LockFreeQueue&) = delete;
+    HISSTools_LockFreeQueue& operator=(const HISSTools_LockFreeQueue&) = delete;
+	
+	bool push(const T& item)
+	{
+		unsigned long write = mWrite.load(std::memory_order_relaxed);
+		unsigned long next = (write + 1) % Size;
+		
+		if (next == mRead.load(std::memory_order_acquire))
+			return FALSE;
+		
+		mItems[write] = item;
+		mWrite.store(next, std::memory_order_release);
+		
+		return TRUE;
+	}
+	
+	bool pop(T& item)
+	{
+		unsigned long read = mRead.load(std::memory_order_relaxed);
+		
+		if (read == mWrite.load(std::memory_order_acquire))
+			return FALSE;
+		
+		item = mItems[read];
+		mRead.store((read + 1) % Size, std::memory_order_release);
+		
+		return TRUE;
+	}
+	
+	bool empty()
+	{
+		return mRead.load(std::memory_order_acquire) == mWrite.load(std::memory_order_acquire);
+	}
+
+private:
+
+	T mItems[Size];
+	
+	std::atomic<unsigned long> mRead;
+	std::atomic<unsigned long> mWrite;
+};
+
+
 template <class T>
 class HISSTools_ThreadSafeMemory
 {